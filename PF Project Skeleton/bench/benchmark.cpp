@@ -0,0 +1,434 @@
+#include "../core/simulation_state.h"
+#include "../core/simulation.h"
+#include "../core/trains.h"
+#include "../core/switches.h"
+#include "../core/io.h"
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+using namespace std;
+
+// ============================================================================
+// BENCH/BENCHMARK.CPP - Tick pipeline microbenchmarks
+// ============================================================================
+// Runs each level to completion several times and reports ns/tick and
+// ns/train-tick for simulateOneTick() end to end and for every phase in
+// isolation, as mean/stddev/min over the repetitions. The cost of reading
+// the clock is measured once and subtracted from every sample. Results can
+// also be written as JSON to track regressions.
+//
+// Besides the levels given on the command line, each level is also run
+// tiled SCALE x SCALE times (--scale) to exercise bigger worlds. Levels after
+// --as-is (e.g. generated synthetic levels) are only run as they are. The
+// tiled copies go to a scratch directory, never next to the levels.
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// PHASES (same order as simulateOneTick)
+// ----------------------------------------------------------------------------
+typedef void (*TickPhase)(SimulationContext &ctx);
+
+static const int phase_count = 10;
+static const TickPhase phases[phase_count] = {
+    spawnTrainsForTick, updateSwitchCounters, queueSwitchFlips,
+    determineAllRoutes, moveAllTrains, applyDeferredFlips,
+    updateSignalLights, applyEmergencyHalt, updateEmergencyHalt,
+    checkArrivals
+};
+static const char* const phaseNames[phase_count] = {
+    "spawnTrainsForTick", "updateSwitchCounters", "queueSwitchFlips",
+    "determineAllRoutes", "moveAllTrains", "applyDeferredFlips",
+    "updateSignalLights", "applyEmergencyHalt", "updateEmergencyHalt",
+    "checkArrivals"
+};
+
+// ----------------------------------------------------------------------------
+// STATISTICS
+// ----------------------------------------------------------------------------
+struct Stats {
+    double mean;
+    double stddev;
+    double min;
+};
+
+static Stats summarize(const vector<double> &samples) {
+    Stats s = {0.0, 0.0, 0.0};
+    if (samples.empty()) return s;
+    s.min = samples[0];
+    for (size_t i = 0; i < samples.size(); i++) {
+        s.mean += samples[i];
+        if (samples[i] < s.min) s.min = samples[i];
+    }
+    s.mean /= samples.size();
+    for (size_t i = 0; i < samples.size(); i++) {
+        s.stddev += (samples[i] - s.mean) * (samples[i] - s.mean);
+    }
+    if (samples.size() > 1) s.stddev = sqrt(s.stddev / (samples.size() - 1));
+    return s;
+}
+
+struct LevelResult {
+    string level;
+    int rows;
+    int columns;
+    int trains;
+    int ticks;
+    long long trainTicks;
+    Stats tick;
+    Stats trainTick;
+    Stats phase[phase_count];
+};
+
+// Cost of one back-to-back pair of clock reads, subtracted from every sample
+static double timerOverheadNs = 0.0;
+
+static void calibrateTimer() {
+    const int samples = 100000;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i = 0; i < samples; i++) {
+        chrono::steady_clock::time_point a = chrono::steady_clock::now();
+        chrono::steady_clock::time_point b = chrono::steady_clock::now();
+        if (b < a) cout << "";
+    }
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    timerOverheadNs = chrono::duration<double, nano>(end - start).count() / samples / 2.0;
+}
+
+static double elapsedNs(chrono::steady_clock::time_point a, chrono::steady_clock::time_point b) {
+    double ns = chrono::duration<double, nano>(b - a).count() - timerOverheadNs;
+    return ns > 0.0 ? ns : 0.0;
+}
+
+static int activeTrains(const SimulationContext &ctx) {
+    int active = 0;
+    for (int i = 0; i < ctx.numOf_trains; i++) {
+        if (ctx.trainRow[i] != -1) active++;
+    }
+    return active;
+}
+
+static bool loadForRun(SimulationContext &ctx, const string &level) {
+    initializeSimulation(ctx);
+    return loadLevelFile(ctx, level);
+}
+
+// ----------------------------------------------------------------------------
+// Benchmark one level.
+// ----------------------------------------------------------------------------
+// End-to-end runs call simulateOneTick() untouched; phase runs time each
+// phase call separately. Loading is never timed.
+// ----------------------------------------------------------------------------
+static bool benchmarkLevel(const string &level, int repetitions, LevelResult &result) {
+    vector<double> tickSamples, trainTickSamples;
+    vector<double> phaseSamples[phase_count];
+    SimulationContext ctx;
+
+    for (int rep = 0; rep < repetitions; rep++) {
+        // End to end
+        if (!loadForRun(ctx, level)) return false;
+        long long trainTicks = 0;
+        double total = 0.0;
+        while (!isSimulationComplete(ctx)) {
+            chrono::steady_clock::time_point a = chrono::steady_clock::now();
+            simulateOneTick(ctx);
+            chrono::steady_clock::time_point b = chrono::steady_clock::now();
+            total += elapsedNs(a, b);
+            trainTicks += activeTrains(ctx);
+        }
+        int ticks = ctx.currentTick;
+        tickSamples.push_back(total / (ticks > 0 ? ticks : 1));
+        trainTickSamples.push_back(total / (trainTicks > 0 ? trainTicks : 1));
+
+        result.rows = ctx.number_rows;
+        result.columns = ctx.number_column;
+        result.trains = ctx.num_spawn;
+        result.ticks = ticks;
+        result.trainTicks = trainTicks;
+
+        // Each phase in isolation
+        if (!loadForRun(ctx, level)) return false;
+        double phaseTotal[phase_count] = {0.0};
+        while (!isSimulationComplete(ctx)) {
+            if (!ctx.simulationRunning) break;
+            for (int p = 0; p < phase_count; p++) {
+                chrono::steady_clock::time_point a = chrono::steady_clock::now();
+                phases[p](ctx);
+                chrono::steady_clock::time_point b = chrono::steady_clock::now();
+                phaseTotal[p] += elapsedNs(a, b);
+            }
+            ctx.currentTick++;
+        }
+        for (int p = 0; p < phase_count; p++) {
+            phaseSamples[p].push_back(phaseTotal[p] / (ctx.currentTick > 0 ? ctx.currentTick : 1));
+        }
+    }
+
+    result.level = level;
+    result.tick = summarize(tickSamples);
+    result.trainTick = summarize(trainTickSamples);
+    for (int p = 0; p < phase_count; p++) result.phase[p] = summarize(phaseSamples[p]);
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// SCRATCH FILES
+// ----------------------------------------------------------------------------
+// Tiled levels are written to --scratch DIR, or else to a fresh mkdtemp
+// directory under $TMPDIR (or /tmp) that is removed again. The files are
+// removed on every way out: normal exit, error returns and SIGINT/SIGTERM.
+// Paths are kept in fixed buffers so the signal handler can unlink them.
+// ----------------------------------------------------------------------------
+static const int max_scratch_files = 64;
+static char scratchFiles[max_scratch_files][PATH_MAX];
+static volatile sig_atomic_t scratchFileCount = 0;
+static char scratchDir[PATH_MAX];
+static volatile sig_atomic_t scratchDirOwned = 0;     // Made by mkdtemp
+
+static void removeScratch() {
+    for (int i = 0; i < scratchFileCount; i++) unlink(scratchFiles[i]);
+    scratchFileCount = 0;
+    if (scratchDirOwned) rmdir(scratchDir);
+    scratchDirOwned = 0;
+}
+
+static void removeScratchOnSignal(int sig) {
+    removeScratch();
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+// Removes the scratch files when main returns
+struct ScratchCleanup {
+    ~ScratchCleanup() { removeScratch(); }
+};
+
+// Use `dir` (or a new temporary directory when empty). False if unusable.
+static bool openScratch(const string &dir) {
+    if (!dir.empty()) {
+        if (dir.size() >= sizeof(scratchDir)) return false;
+        strcpy(scratchDir, dir.c_str());
+        return access(scratchDir, W_OK) == 0;
+    }
+    const char *tmp = getenv("TMPDIR");
+    string pattern = string(tmp && *tmp ? tmp : "/tmp") + "/switchback_bench.XXXXXX";
+    if (pattern.size() >= sizeof(scratchDir)) return false;
+    strcpy(scratchDir, pattern.c_str());
+    if (!mkdtemp(scratchDir)) return false;
+    scratchDirOwned = 1;
+    signal(SIGINT, removeScratchOnSignal);
+    signal(SIGTERM, removeScratchOnSignal);
+    return true;
+}
+
+// Reserve a scratch path for `name` (registered before it is written, so a
+// half-written file is removed too). Empty when the table is full.
+static string addScratchFile(const string &name) {
+    string path = string(scratchDir) + "/" + name;
+    if (scratchFileCount >= max_scratch_files || path.size() >= PATH_MAX) return "";
+    strcpy(scratchFiles[scratchFileCount], path.c_str());
+    scratchFileCount = scratchFileCount + 1;
+    return path;
+}
+
+// ----------------------------------------------------------------------------
+// Write a level tiled factor x factor times.
+// ----------------------------------------------------------------------------
+// Map, switches and weather are copied; every train is repeated once per tile
+// with its spawn moved into that tile.
+// ----------------------------------------------------------------------------
+static bool writeScaledLevel(const string &level, int factor, const string &outPath) {
+    SimulationContext ctx;
+    if (!loadForRun(ctx, level)) return false;
+
+    ofstream out(outPath.c_str());
+    if (!out.is_open()) return false;
+
+    const char* weatherNames[weather_types] = {"NORMAL", "RAIN", "FOG"};
+    out << "ROWS:\n" << ctx.number_rows * factor << "\n\n";
+    out << "COLS:\n" << ctx.number_column * factor << "\n\n";
+    out << "SEED:\n" << ctx.levelSeed << "\n\n";
+    out << "WEATHER:\n" << weatherNames[ctx.weather_type] << "\n\n";
+    out << "MAP:\n";
+    for (int tr = 0; tr < factor; tr++) {
+        for (int r = 0; r < ctx.number_rows; r++) {
+            string line;
+            for (int tc = 0; tc < factor; tc++) {
+                line.append(ctx.originalGrid[r], ctx.number_column);
+            }
+            out << line << "\n";
+        }
+    }
+    out << "\nSWITCHES:\n";
+    for (int i = 0; i < ctx.numSwitches; i++) {
+        out << ctx.switchLetter[i] << " " << (ctx.switchMode[i] == GLOBAL ? "GLOBAL" : "PER_DIR")
+            << " " << ctx.switchState[i];
+        for (int k = 0; k < 4; k++) out << " " << ctx.switchK[i][k];
+        out << " STRAIGHT TURN\n";
+    }
+    out << "\nTRAINS:\n";
+    for (int tr = 0; tr < factor; tr++) {
+        for (int tc = 0; tc < factor; tc++) {
+            for (int i = 0; i < ctx.num_spawn; i++) {
+                // The loader's first spawn candidate is (row-1, col-1)
+                out << ctx.spawnTick[i] << " "
+                    << ctx.spawnn_Column[i] + tc * ctx.number_column + 1 << " "
+                    << ctx.spawnn_Row[i] + tr * ctx.number_rows + 1 << " "
+                    << ctx.spawnDirection[i] << " " << ctx.spawnColor[i] << "\n";
+            }
+        }
+    }
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// OUTPUT
+// ----------------------------------------------------------------------------
+static void printResult(const LevelResult &r) {
+    cout << r.level << " (" << r.rows << "x" << r.columns << ", " << r.trains
+         << " trains, " << r.ticks << " ticks)" << endl;
+    cout << "  simulateOneTick      " << r.tick.mean << " ns/tick (+/- " << r.tick.stddev
+         << ", min " << r.tick.min << "), " << r.trainTick.mean << " ns/train-tick" << endl;
+    for (int p = 0; p < phase_count; p++) {
+        cout << "  " << phaseNames[p];
+        for (int pad = (int)strlen(phaseNames[p]); pad < 21; pad++) cout << ' ';
+        cout << r.phase[p].mean << " ns/tick (+/- " << r.phase[p].stddev << ")" << endl;
+    }
+}
+
+static string jsonEscape(const string &text) {
+    string escaped;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '"' || text[i] == '\\') escaped += '\\';
+        escaped += text[i];
+    }
+    return escaped;
+}
+
+static void writeStats(ofstream &out, const Stats &s) {
+    out << "{\"mean\": " << s.mean << ", \"stddev\": " << s.stddev << ", \"min\": " << s.min << "}";
+}
+
+static bool writeJson(const string &path, const vector<LevelResult> &results, int repetitions) {
+    ofstream out(path.c_str());
+    if (!out.is_open()) return false;
+    out << "{\n  \"repetitions\": " << repetitions << ",\n  \"timer_overhead_ns\": "
+        << timerOverheadNs << ",\n  \"levels\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const LevelResult &r = results[i];
+        out << "    {\n";
+        out << "      \"level\": \"" << jsonEscape(r.level) << "\",\n";
+        out << "      \"rows\": " << r.rows << ", \"cols\": " << r.columns
+            << ", \"trains\": " << r.trains << ", \"ticks\": " << r.ticks
+            << ", \"train_ticks\": " << r.trainTicks << ",\n";
+        out << "      \"tick_ns\": ";
+        writeStats(out, r.tick);
+        out << ",\n      \"train_tick_ns\": ";
+        writeStats(out, r.trainTick);
+        out << ",\n      \"phase_tick_ns\": {\n";
+        for (int p = 0; p < phase_count; p++) {
+            out << "        \"" << phaseNames[p] << "\": ";
+            writeStats(out, r.phase[p]);
+            out << (p + 1 < phase_count ? ",\n" : "\n");
+        }
+        out << "      }\n    }" << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    int repetitions = 20;
+    int scale = 4;
+    string jsonPath;
+    string scratch;
+    vector<string> levels;
+    vector<string> asIsLevels;
+    bool asIs = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) repetitions = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) scale = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) jsonPath = argv[++i];
+        else if (strcmp(argv[i], "--scratch") == 0 && i + 1 < argc) scratch = argv[++i];
+        else if (strcmp(argv[i], "--as-is") == 0) asIs = true;
+        else if (asIs) asIsLevels.push_back(argv[i]);
+        else levels.push_back(argv[i]);
+    }
+    if (levels.empty() && asIsLevels.empty()) {
+        cout << "Usage: ./switchback_bench [--reps N] [--scale N] [--json out.json] [--scratch DIR]"
+             << " <level_file>... "
+             << "[--as-is <level_file>...]" << endl;
+        return 1;
+    }
+    if (repetitions < 1) repetitions = 1;
+
+    calibrateTimer();
+
+    ScratchCleanup cleanup;
+    if (scale > 1 && !levels.empty() && !openScratch(scratch)) {
+        cout << "Error: Cannot use scratch directory "
+             << (scratch.empty() ? "(temporary)" : scratch) << " for scaled levels" << endl;
+        return 1;
+    }
+
+    // Silence the loader's "Level loaded" lines while benchmarking
+    streambuf* console = cout.rdbuf();
+    vector<LevelResult> results;
+    vector<string> labels(levels);
+    size_t shipped = levels.size();
+    for (size_t i = 0; i < shipped && scale > 1; i++) {
+        string suffix = ".x" + to_string(scale);
+        string base = levels[i].substr(levels[i].find_last_of('/') + 1);
+        string scaled = addScratchFile(to_string(i) + "_" + base + suffix + ".lvl");
+        if (scaled.empty()) {
+            cout << "Error: Too many levels to scale, skipping " << levels[i] << endl;
+            continue;
+        }
+        cout.rdbuf(0);
+        bool ok = writeScaledLevel(levels[i], scale, scaled);
+        cout.rdbuf(console);
+        cout.clear();
+        if (ok) {
+            levels.push_back(scaled);
+            labels.push_back(levels[i] + suffix);
+        }
+    }
+    levels.insert(levels.end(), asIsLevels.begin(), asIsLevels.end());
+    labels.insert(labels.end(), asIsLevels.begin(), asIsLevels.end());
+
+    for (size_t i = 0; i < levels.size(); i++) {
+        LevelResult result;
+        cout.rdbuf(0);
+        bool ok = benchmarkLevel(levels[i], repetitions, result);
+        cout.rdbuf(console);
+        cout.clear();
+        if (!ok) {
+            cout << "Error: Failed to load level file: " << labels[i] << endl;
+            continue;
+        }
+        result.level = labels[i];
+        printResult(result);
+        results.push_back(result);
+    }
+
+    removeScratch();
+
+    if (!jsonPath.empty()) {
+        if (!writeJson(jsonPath, results, repetitions)) {
+            cout << "Error: Could not write " << jsonPath << endl;
+            return 1;
+        }
+        cout << "Results written to " << jsonPath << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include "../core/level_corpus.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+using namespace std;
+
+// ============================================================================
+// BENCH/PARSE_BENCHMARK.CPP - Level parse throughput
+// ============================================================================
+// Loads a corpus of levels (directories of .lvl files and/or single files)
+// with loadLevelCorpus and reports throughput in MB/s and levels/s, best of
+// --reps runs. Every level that fails to load is listed as file:line.
+// ============================================================================
+
+static void printUsage() {
+    cout << "Usage: ./switchback_parsebench [--threads N] [--reps N] <dir|level_file>...\n"
+         << "  --threads N  worker threads (default: one per hardware thread)\n"
+         << "  --reps N     load the corpus N times and keep the fastest (default 5)\n";
+}
+
+// Expand directories into their .lvl files
+static bool collectFiles(const vector<string> &paths, vector<string> &files) {
+    for (size_t i = 0; i < paths.size(); i++) {
+        struct stat status;
+        if (stat(paths[i].c_str(), &status) == 0 && S_ISDIR(status.st_mode)) {
+            if (!listLevelFiles(paths[i], files)) {
+                cout << "Error: Could not read directory: " << paths[i] << endl;
+                return false;
+            }
+        } else {
+            files.push_back(paths[i]);
+        }
+    }
+    return true;
+}
+
+static void printError(const LevelLoadError &error) {
+    cout << "  " << error.file;
+    if (error.line > 0) cout << ":" << error.line;
+    cout << ": " << error.message << endl;
+}
+
+int main(int argc, char* argv[]) {
+    int threads = 0;
+    int repetitions = 5;
+    vector<string> paths;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) repetitions = atoi(argv[++i]);
+        else if (argv[i][0] != '-') paths.push_back(argv[i]);
+        else {
+            printUsage();
+            return 1;
+        }
+    }
+    if (paths.empty()) {
+        printUsage();
+        return 1;
+    }
+    if (repetitions < 1) repetitions = 1;
+
+    vector<string> files;
+    if (!collectFiles(paths, files)) return 1;
+    if (files.empty()) {
+        cout << "Error: No level files found" << endl;
+        return 1;
+    }
+
+    double best = 0;
+    vector<LoadedLevel> levels;
+    size_t loaded = 0;
+    for (int rep = 0; rep < repetitions; rep++) {
+        levels.clear();                         // Free the last run outside the timing
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        loaded = loadLevelCorpus(files, threads, levels);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (rep == 0 || seconds < best) best = seconds;
+    }
+
+    size_t bytes = 0;
+    for (size_t i = 0; i < levels.size(); i++) bytes += levels[i].bytes;
+    double megabytes = bytes / (1024.0 * 1024.0);
+
+    printf("files:     %zu (%zu loaded, %zu failed)\n", files.size(), loaded, files.size() - loaded);
+    printf("size:      %.2f MB\n", megabytes);
+    printf("time:      %.3f ms (best of %d)\n", best * 1e3, repetitions);
+    printf("MB/s:      %.1f\n", best > 0 ? megabytes / best : 0.0);
+    printf("levels/s:  %.0f\n", best > 0 ? files.size() / best : 0.0);
+    fflush(stdout);
+
+    if (loaded < files.size()) {
+        cout << "Errors:" << endl;
+        for (size_t i = 0; i < levels.size(); i++) {
+            if (!levels[i].loaded) printError(levels[i].error);
+        }
+    }
+    return loaded == files.size() ? 0 : 2;
+}
@@ -0,0 +1,141 @@
+#include "fork.h"
+#include "simulation_state.h"
+#include "simulation.h"
+#include "grid.h"
+#include "switches.h"
+#include "work_stealing.h"
+#include <cstring>
+#include <memory>
+
+using namespace std;
+
+// ============================================================================
+// FORK.CPP - Forked simulations for what-if runs
+// ============================================================================
+
+static void copyInts(int *to, const int *from, int count) {
+    if (count > 0) memcpy(to, from, (size_t)count * sizeof(int));
+}
+
+// ----------------------------------------------------------------------------
+// Fork a running simulation.
+// ----------------------------------------------------------------------------
+// shareWorld points the fork at the parent's level and gives it fresh
+// arrays; everything a tick can change is copied in here. Planning scratch
+// and the collision index are rebuilt every tick, so they start fresh.
+// ----------------------------------------------------------------------------
+bool forkSimulation(SimulationContext &parent, SimulationContext &fork) {
+    if (&parent == &fork) return false;
+    if (!shareWorld(fork, parent)) return false;
+    int trains = parent.trainCapacity;
+
+    // Trains
+    fork.numOf_trains = parent.numOf_trains;
+    copyInts(fork.trainRow, parent.trainRow, trains);
+    copyInts(fork.trainColumn, parent.trainColumn, trains);
+    copyInts(fork.trainColor, parent.trainColor, trains);
+    copyInts(fork.trainDirection, parent.trainDirection, trains);
+    copyInts(fork.trainWait, parent.trainWait, trains);
+
+    // Switches and their pending work
+    fork.numSwitches = parent.numSwitches;
+    memcpy(fork.switchSignal, parent.switchSignal, sizeof(fork.switchSignal));
+    memcpy(fork.switchLetter, parent.switchLetter, sizeof(fork.switchLetter));
+    memcpy(fork.switchState, parent.switchState, sizeof(fork.switchState));
+    memcpy(fork.switchMode, parent.switchMode, sizeof(fork.switchMode));
+    memcpy(fork.switchCounter, parent.switchCounter, sizeof(fork.switchCounter));
+    memcpy(fork.switchK, parent.switchK, sizeof(fork.switchK));
+    memcpy(fork.switchFlipped, parent.switchFlipped, sizeof(fork.switchFlipped));
+    fork.numSwitchEntries = parent.numSwitchEntries;
+    copyInts(fork.switchEntries, parent.switchEntries, parent.numSwitchEntries);
+    fork.numDueCounters = parent.numDueCounters;
+    copyInts(fork.dueCounters, parent.dueCounters, parent.numDueCounters);
+    fork.numQueuedFlips = parent.numQueuedFlips;
+    copyInts(fork.flipQueue, parent.flipQueue, parent.numQueuedFlips);
+
+    // Spawn and destination points
+    fork.num_spawn = parent.num_spawn;
+    copyInts(fork.spawnn_Row, parent.spawnn_Row, trains);
+    copyInts(fork.spawnn_Column, parent.spawnn_Column, trains);
+    copyInts(fork.spawnTick, parent.spawnTick, trains);
+    copyInts(fork.spawnTrainID, parent.spawnTrainID, trains);
+    copyInts(fork.spawnDirection, parent.spawnDirection, trains);
+    copyInts(fork.spawnColor, parent.spawnColor, trains);
+    fork.numDest = parent.numDest;
+    copyInts(fork.destinationRow, parent.destinationRow, trains);
+    copyInts(fork.destinationColumn, parent.destinationColumn, trains);
+    copyInts(fork.destinationTrainID, parent.destinationTrainID, trains);
+    copyInts(fork.trainDestination, parent.trainDestination, trains);
+
+    // Simulation parameters and metrics
+    fork.currentTick       = parent.currentTick;
+    fork.totalTicks        = parent.totalTicks;
+    fork.levelSeed         = parent.levelSeed;
+    fork.levelHash         = parent.levelHash;
+    fork.weather_type      = parent.weather_type;
+    fork.simulationRunning = parent.simulationRunning;
+    fork.rngState          = parent.rngState;
+    fork.trainsReached     = parent.trainsReached;
+    fork.crashed_trains    = parent.crashed_trains;
+    fork.totalWaitTicks    = parent.totalWaitTicks;
+    fork.T_energy          = parent.T_energy;
+    fork.switchFlips       = parent.switchFlips;
+    fork.signalViolations  = parent.signalViolations;
+
+    // Emergency halts
+    if (parent.number_rows > 0) {
+        copyInts(fork.emergencyHalt[0], parent.emergencyHalt[0],
+                 parent.number_rows * parent.number_column);
+    }
+    fork.emergencyHaltActive = parent.emergencyHaltActive;
+    fork.numHaltZones = parent.numHaltZones;
+    copyInts(fork.haltZoneRow, parent.haltZoneRow, parent.numHaltZones);
+    copyInts(fork.haltZoneColumn, parent.haltZoneColumn, parent.numHaltZones);
+    copyInts(fork.haltZoneExpiry, parent.haltZoneExpiry, parent.numHaltZones);
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// One branch: fork, edit, step.
+// ----------------------------------------------------------------------------
+static bool runBranch(SimulationContext &parent, SimulationContext &fork, WhatIfBranch &branch,
+                      int ticks) {
+    if (!forkSimulation(parent, fork)) return false;
+    for (size_t s = 0; s < branch.switchToggles.size(); s++) {
+        int id = branch.switchToggles[s];
+        if (id < 0 || id >= fork.numSwitches) return false;
+        toggleSwitchState(fork, id);
+    }
+    for (size_t t = 0; t < branch.safetyToggles.size(); t++) {
+        int row = branch.safetyToggles[t].first;
+        int col = branch.safetyToggles[t].second;
+        if (!isInBounds(fork, row, col) || !toggleSafetyTile(fork, row, col)) return false;
+    }
+
+    int endTick = fork.currentTick + ticks;
+    while (fork.currentTick < endTick && !isSimulationComplete(fork)) simulateOneTick(fork);
+    branch.delivered = fork.trainsReached;
+    branch.crashed   = fork.crashed_trains;
+    branch.waitTicks = fork.totalWaitTicks;
+    branch.endTick   = fork.currentTick;
+    branch.finished  = true;
+    return true;
+}
+
+size_t runWhatIf(SimulationContext &parent, vector<WhatIfBranch> &branches, int ticks,
+                 int threads) {
+    threads = workStealingThreads(branches.size(), threads);
+    vector<unique_ptr<SimulationContext> > forks(threads);
+    for (int t = 0; t < threads; t++) forks[t].reset(new SimulationContext());
+
+    runWorkStealing(branches.size(), threads, [&](size_t index, int worker) {
+        branches[index].finished = false;
+        runBranch(parent, *forks[worker], branches[index], ticks);
+    });
+
+    size_t finished = 0;
+    for (size_t i = 0; i < branches.size(); i++) {
+        if (branches[i].finished) finished++;
+    }
+    return finished;
+}
@@ -0,0 +1,49 @@
+#ifndef FORK_H
+#define FORK_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// ============================================================================
+// FORK.H - Forked simulations for what-if runs
+// ============================================================================
+// A fork continues a running simulation from its current tick. It reads the
+// parent's level data (map, tile records, distance field, track graph) and
+// copies only what a run changes: trains, switches, spawn bookkeeping,
+// halts, metrics and the random stream. Forks are independent of each other
+// and of the parent, so each can be stepped on its own thread, and
+// toggleSwitchState()/toggleSafetyTile() on a fork only affect that fork (a
+// safety tile edit gives the fork its own copy of the level first).
+//
+// The parent must outlive its forks and keep its level while they exist;
+// toggleSafetyTile() on the parent is refused until they are gone.
+// ============================================================================
+
+struct SimulationContext;
+
+// Start `fork` from `parent`'s state between ticks, replacing whatever fork
+// held. Returns false if memory is exhausted.
+bool forkSimulation(SimulationContext &parent, SimulationContext &fork);
+
+// One what-if question: edits made at the fork tick, and what followed.
+struct WhatIfBranch {
+    std::vector<int> switchToggles;                     // Switch indices to toggle
+    std::vector<std::pair<int, int> > safetyToggles;    // (row, col) tiles to toggle
+    bool finished;          // False if the fork failed or an edit was refused
+    int delivered;
+    int crashed;
+    int waitTicks;
+    int endTick;            // Tick the branch stopped at
+
+    WhatIfBranch() : finished(false), delivered(0), crashed(0), waitTicks(0), endTick(0) {}
+};
+
+// Fork `parent` once per branch, apply the branch's edits and step the fork
+// `ticks` ticks (or until the simulation completes). Branches run on
+// `threads` workers (0 = one per hardware thread); the parent is only read.
+// Returns the number of finished branches.
+size_t runWhatIf(SimulationContext &parent, std::vector<WhatIfBranch> &branches, int ticks,
+                 int threads);
+
+#endif
@@ -1,5 +1,7 @@
 #include "grid.h"
 #include "simulation_state.h"
+#include "routing.h"
+#include "track_graph.h"
 
 // ============================================================================
 // GRID.CPP - Grid utilities
@@ -10,20 +12,19 @@
 // ----------------------------------------------------------------------------
 // Returns true if x,y are within bounds.
 // ----------------------------------------------------------------------------
-bool isInBounds(int i,int j) {
-    return(i>=0&&i<number_rows&&j>=0&&j<number_column);
+bool isInBounds(const SimulationContext &ctx, int i,int j) {
+    return(i>=0&&i<ctx.number_rows&&j>=0&&j<ctx.number_column);
 }
 // ----------------------------------------------------------------------------
 // Check if a tile is a track tile.
 // ----------------------------------------------------------------------------
 // Returns true if the tile can be traversed by trains.
 // ----------------------------------------------------------------------------
-bool isTrackTile(int i,int j) {
-    if(!isInBounds(i,j)) 
+bool isTrackTile(const SimulationContext &ctx, int i,int j) {
+    if(!isInBounds(ctx, i,j)) 
     return 0;
-    char tile=grid[i][j];
-    return(tile==horizontal_track||tile==vertical_track||tile==right_curve||
-    tile==left_curve||tile==crossing||tile==spawn||tile==destination||tile=='=');
+    unsigned char tileClass=ctx.tileInfo[i*ctx.number_column+j].tileClass;
+    return(tileClass!=tile_empty&&tileClass!=tile_switch&&tileClass!=tile_other);
 }
 
 // ----------------------------------------------------------------------------
@@ -31,10 +32,9 @@ bool isTrackTile(int i,int j) {
 // ----------------------------------------------------------------------------
 // Returns true if the tile is 'A'..'Z'.
 // ----------------------------------------------------------------------------
-bool isSwitchTile(int i,int j) {
-    if(!isInBounds(i,j)) return 0;
-    char tile=grid[i][j];
-    return(tile>=start_switch&&tile<=end_switch);
+bool isSwitchTile(const SimulationContext &ctx, int i,int j) {
+    if(!isInBounds(ctx, i,j)) return 0;
+    return ctx.tileInfo[i*ctx.number_column+j].switchIndex>=0;
 }
 
 // ----------------------------------------------------------------------------
@@ -42,9 +42,9 @@ bool isSwitchTile(int i,int j) {
 // ----------------------------------------------------------------------------
 // Maps 'A'..'Z' to 0..25, else -1.
 // ----------------------------------------------------------------------------
-int getSwitchIndex(int i,int j) {
-    if(!isSwitchTile(i,j)) return -1;
-    return grid[i][j]-start_switch;
+int getSwitchIndex(const SimulationContext &ctx, int i,int j) {
+    if(!isInBounds(ctx, i,j)) return -1;
+    return ctx.tileInfo[i*ctx.number_column+j].switchIndex;
 }
 
 // ----------------------------------------------------------------------------
@@ -52,14 +52,9 @@ int getSwitchIndex(int i,int j) {
 // ----------------------------------------------------------------------------
 // Returns true if x,y is a spawn.
 // ----------------------------------------------------------------------------
-bool isSpawnPoint(int i,int j) {
-    if(!isInBounds(i,j)) return 0;
-    for(int k=0;k<num_spawn;k++){
-        if(spawnn_Row[k]==i&&spawnn_Column[k]==j){
-            return 1;
-        }
-    }
-    return 0;
+bool isSpawnPoint(const SimulationContext &ctx, int i,int j) {
+    if(!isInBounds(ctx, i,j)) return 0;
+    return (ctx.tileInfo[i*ctx.number_column+j].pointMask&point_spawn)!=0;
 }
 
 // ----------------------------------------------------------------------------
@@ -67,44 +62,132 @@ bool isSpawnPoint(int i,int j) {
 // ----------------------------------------------------------------------------
 // Returns true if x,y is a destination.
 // ----------------------------------------------------------------------------
-bool isDestinationPoint(int i,int j) {
-    if(!isInBounds(i,j)) return 0;
-    for(int k=0;k<numDest;k++){
-        if(destinationRow[k]==i&&destinationColumn[k]==j){
-            return 1;
-        }
-    }
-    return 0;
+bool isDestinationPoint(const SimulationContext &ctx, int i,int j) {
+    if(!isInBounds(ctx, i,j)) return 0;
+    return (ctx.tileInfo[i*ctx.number_column+j].pointMask&point_destination)!=0;
 }
 
 // ----------------------------------------------------------------------------
 // Toggle a safety tile.
 // ----------------------------------------------------------------------------
-// Returns true if toggled successfully.
+// Returns true if toggled successfully. A fork copies the level it shares
+// before its first edit; a context whose level forks are reading refuses.
 // ----------------------------------------------------------------------------
-bool toggleSafetyTile(int i,int j) {
-     if(grid[i][j]=='='){
+bool toggleSafetyTile(SimulationContext &ctx, int i,int j) {
+    if(ctx.levelForks>0) return false;
+    bool routed=ctx.routeField||ctx.routePlanner;
+    bool graphed=ctx.trackGraph!=0;
+    if(!detachLevel(ctx)) return false;
+
+     if(ctx.grid[i][j]=='='){
         //Currently a safety tile so when we toggle off
         //Check if this was an original safety tile
-        if(originalGrid[i][j]=='='){
+        if(ctx.originalGrid[i][j]=='='){
             //Replace safety tile with horizontal track
-            grid[i][j]='-';
+            ctx.grid[i][j]='-';
         }
         else{
             //Reset to original tile
-            grid[i][j]=originalGrid[i][j];
+            ctx.grid[i][j]=ctx.originalGrid[i][j];
         }
-        safetyDelay[i][j]=0;
+        ctx.safetyDelay[i][j]=0;
     }
     else{
         //Currently not a safety tile so when we toggle on
         //Store current tile
-        if(originalGrid[i][j]!='='&&originalGrid[i][j]==grid[i][j]){
+        if(ctx.originalGrid[i][j]!='='&&ctx.originalGrid[i][j]==ctx.grid[i][j]){
             // Save the original
-            originalGrid[i][j]=grid[i][j];
+            ctx.originalGrid[i][j]=ctx.grid[i][j];
         }
-        grid[i][j]='=';
-        safetyDelay[i][j]=1;
+        ctx.grid[i][j]='=';
+        ctx.safetyDelay[i][j]=1;
     }
+    refreshTileInfo(ctx, i,j);
+    //Safety tiles change travel times (and turning on covered tiles)
+    if(routed) buildRouteField(ctx);
+    //...and which straight runs can be entered from the side
+    if(graphed) buildTrackGraph(ctx);
     return true;
 }
+
+// ----------------------------------------------------------------------------
+// Tile records.
+// ----------------------------------------------------------------------------
+// Class of a tile character.
+// ----------------------------------------------------------------------------
+static unsigned char classifyTile(char tile) {
+    switch(tile){
+        case space:            return tile_empty;
+        case horizontal_track: return tile_horizontal;
+        case vertical_track:   return tile_vertical;
+        case right_curve:      return tile_right_curve;
+        case left_curve:       return tile_left_curve;
+        case crossing:         return tile_crossing;
+        case spawn:            return tile_spawn;
+        case destination:      return tile_destination;
+        case '=':              return tile_safety;
+        default:               break;
+    }
+    if(tile>=start_switch&&tile<=end_switch) return tile_switch;
+    return tile_other;
+}
+
+// Re-read one tile's classes and switch index from the grid
+static void classifyCell(SimulationContext &ctx, int i,int j) {
+    TileInfo &info=ctx.tileInfo[i*ctx.number_column+j];
+    char tile=ctx.grid[i][j];
+    info.tileClass=classifyTile(tile);
+    info.routeClass=info.tileClass;
+    if(tile=='='){
+        //A safety tile turns like the tile it covers (plain '=' acts as '-').
+        //A covered switch is not active, so trains keep their heading.
+        char under=ctx.originalGrid[i][j];
+        info.routeClass=(under=='=')?tile_horizontal:classifyTile(under);
+        if(info.routeClass==tile_switch) info.routeClass=tile_other;
+    }
+    //'S' and 'D' are letters too, so they keep a switch index
+    info.switchIndex=(tile>=start_switch&&tile<=end_switch)?(signed char)(tile-start_switch):-1;
+}
+
+// Recompute one tile's neighbour masks from its neighbours' classes
+static void updateNeighbourMasks(SimulationContext &ctx, int i,int j) {
+    TileInfo &info=ctx.tileInfo[i*ctx.number_column+j];
+    info.trackMask=0;
+    info.openMask=0;
+    for(int d=0;d<4;d++){
+        int ni=i+row_change[d];
+        int nj=j+column_change[d];
+        if(!isInBounds(ctx, ni,nj)) continue;
+        unsigned char neighbour=ctx.tileInfo[ni*ctx.number_column+nj].tileClass;
+        if(neighbour!=tile_empty) info.openMask|=(unsigned char)(1<<d);
+        if(neighbour!=tile_empty&&neighbour!=tile_other) info.trackMask|=(unsigned char)(1<<d);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Build every tile record from the grid (after loading a level).
+// ----------------------------------------------------------------------------
+void buildTileInfo(SimulationContext &ctx) {
+    for(int i=0;i<ctx.number_rows;i++)
+        for(int j=0;j<ctx.number_column;j++)
+            classifyCell(ctx, i,j);
+    for(int i=0;i<ctx.number_rows;i++)
+        for(int j=0;j<ctx.number_column;j++)
+            updateNeighbourMasks(ctx, i,j);
+}
+
+// ----------------------------------------------------------------------------
+// Refresh the records touched by an edit of tile i,j.
+// ----------------------------------------------------------------------------
+// The tile itself and the masks of its four neighbours.
+// ----------------------------------------------------------------------------
+void refreshTileInfo(SimulationContext &ctx, int i,int j) {
+    if(!isInBounds(ctx, i,j)) return;
+    classifyCell(ctx, i,j);
+    updateNeighbourMasks(ctx, i,j);
+    for(int d=0;d<4;d++){
+        int ni=i+row_change[d];
+        int nj=j+column_change[d];
+        if(isInBounds(ctx, ni,nj)) updateNeighbourMasks(ctx, ni,nj);
+    }
+}
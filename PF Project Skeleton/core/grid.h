@@ -7,26 +7,34 @@
 // Functions for working with the 2D grid map.
 // ============================================================================
 
+struct SimulationContext;
+
 // Check if a position is within grid bounds
-bool isInBounds(int i,int j);
+bool isInBounds(const SimulationContext &ctx, int i,int j);
 
 // Check if a tile is a track (can trains move on it?)
-bool isTrackTile(int i,int j);
+bool isTrackTile(const SimulationContext &ctx, int i,int j);
 
 // Check if a tile is a switch (A-Z)
-bool isSwitchTile(int i,int j);
+bool isSwitchTile(const SimulationContext &ctx, int i,int j);
 
 // Get the switch index (0-25) from a switch character (A-Z)
-int getSwitchIndex(int i,int j);
+int getSwitchIndex(const SimulationContext &ctx, int i,int j);
 
 // Check if a position is a spawn point
-bool isSpawnPoint(int i,int j);
+bool isSpawnPoint(const SimulationContext &ctx, int i,int j);
 
 // Check if a position is a destination point
-bool isDestinationPoint(int i,int j);
+bool isDestinationPoint(const SimulationContext &ctx, int i,int j);
 
 // Place or remove a safety tile at a position (for mouse editing)
 // Returns true if successful
-bool toggleSafetyTile(int i,int j);
+bool toggleSafetyTile(SimulationContext &ctx, int i,int j);
+
+// Build every per-tile record (class, neighbour masks, switch index)
+void buildTileInfo(SimulationContext &ctx);
+
+// Refresh the records affected by a change to tile i,j
+void refreshTileInfo(SimulationContext &ctx, int i,int j);
 
 #endif
@@ -1,12 +1,19 @@
 #include "io.h"
 #include "simulation_state.h"
 #include "grid.h"
+#include "routing.h"
+#include "track_graph.h"
+#include "trace_format.h"
+#include <atomic>
+#include <chrono>
 #include <fstream>
 #include <cstring>
 #include <cstdio>
 #include <cstdlib>
 #include <iostream>
 #include <string>
+#include <thread>
+#include <vector>
 
 using namespace std;
 
@@ -14,29 +21,154 @@ using namespace std;
 // IO.CPP - Level I/O and logging
 // ============================================================================
 
-bool loadLevelFile(string filename)
+// ----------------------------------------------------------------------------
+// Line number (from 1) of a byte offset in a file, 0 if unknown.
+// ----------------------------------------------------------------------------
+static int lineAt(const string &filename,streamoff offset)
 {
-    ifstream file(filename);
+    if(offset<0) return 0;
+    ifstream file(filename,ios::binary);
+    int line=1;
+    char c;
+    for(streamoff k=0;k<offset&&file.get(c);k++)
+    {
+        if(c=='\n') line++;
+    }
+    return line;
+}
 
+// Where a failed extraction stopped (clears the stream's error state)
+static streamoff failedAt(ifstream &file)
+{
+    file.clear();
+    return file.tellg();
+}
+
+// ----------------------------------------------------------------------------
+// Report a load error: into `error` when given, else on the console.
+// ----------------------------------------------------------------------------
+static bool failLoad(LevelLoadError *error,const string &filename,int line,const string &message)
+{
+    if(error)
+    {
+        error->file=filename;
+        error->line=line;
+        error->message=message;
+    }
+    else if(line>0)
+    {
+        cout<<"Error:"<<filename<<":"<<line<<": "<<message<<"."<<endl;
+    }
+    else
+    {
+        cout<<"Error:"<<message<<"."<<endl;
+    }
+    return false;
+}
+
+// ----------------------------------------------------------------------------
+// Read the world size of a level before parsing it.
+// ----------------------------------------------------------------------------
+// Finds ROWS/COLS and counts TRAINS entries so the world arena can be sized
+// once, up front, instead of clipping the level to fixed array sizes.
+// ----------------------------------------------------------------------------
+static bool scanLevelSize(const string &filename,int &rows,int &columns,int &trains,
+                          LevelLoadError *error)
+{
+    ifstream file(filename);
     if(!file.is_open())
     {
-        cout<<"Error:Could not open level file." << endl;
-        return false;
+        return failLoad(error,filename,0,"Could not open level file");
     }
 
-    //Print empty space tiles for remainign rows and columns
-    for (int r=0;r<maximum_rows;r++)
+    rows=0;
+    columns=0;
+    trains=0;
+    bool hasRows=false;
+    bool hasColumns=false;
+    string current_word;
+    while(file>>current_word)
     {
-        for(int c=0;c<maximum_Columns;c++)
+        if(current_word=="ROWS:")
         {
-            grid[r][c]=space;
+            if(!(file>>rows)||rows<0)
+                return failLoad(error,filename,lineAt(filename,failedAt(file)),"ROWS: expects a non-negative number");
+            hasRows=true;
+        }
+        else if(current_word=="COLS:")
+        {
+            if(!(file>>columns)||columns<0)
+                return failLoad(error,filename,lineAt(filename,failedAt(file)),"COLS: expects a non-negative number");
+            hasColumns=true;
+        }
+        else if(current_word=="TRAINS:")
+        {
+            //Each train is "tick col row direction color"
+            int value;
+            int fields=0;
+            while(file>>value)
+            {
+                fields++;
+            }
+            trains=(fields+4)/5;
+            break;
         }
     }
+    if(!hasRows) return failLoad(error,filename,0,"Missing ROWS:");
+    if(!hasColumns) return failLoad(error,filename,0,"Missing COLS:");
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// FNV-1a hash of the level file bytes (identifies the level in traces and
+// the level cache).
+// ----------------------------------------------------------------------------
+unsigned long long hashLevelFile(const string &filename)
+{
+    unsigned long long hash=14695981039346656037ULL;
+    FILE *file=fopen(filename.c_str(),"rb");
+    if(!file) return 0;
+    unsigned char chunk[4096];
+    size_t count;
+    while((count=fread(chunk,1,sizeof(chunk),file))>0)
+    {
+        for(size_t k=0;k<count;k++)
+        {
+            hash^=chunk[k];
+            hash*=1099511628211ULL;
+        }
+    }
+    fclose(file);
+    return hash;
+}
+
+bool loadLevelFile(SimulationContext &ctx, string filename, LevelLoadError *error)
+{
+    int levelRows=0,levelColumns=0,levelTrains=0;
+    if(!scanLevelSize(filename,levelRows,levelColumns,levelTrains,error))
+    {
+        return false;
+    }
+
+    ifstream file(filename);
+
+    if(!file.is_open())
+    {
+        return failLoad(error,filename,0,"Could not open level file");
+    }
+
+    ctx.levelHash=hashLevelFile(filename);
+
+    //Size the world for this level; every tile starts as empty space
+    if(!allocateWorld(ctx, levelRows,levelColumns,levelTrains))
+    {
+        return failLoad(error,filename,0,"Level is too large to allocate");
+    }
 
     //Reset counting values
-    numSwitches=0;
-    num_spawn=0;
-    numDest=0;
+    ctx.numSwitches=0;
+    ctx.num_spawn=0;
+    ctx.numDest=0;
 
     string current_word;
     string pending_header= "";
@@ -58,25 +190,23 @@ bool loadLevelFile(string filename)
             }
         }
         //Read level information
-        if(current_word=="ROWS:")
+        //ROWS and COLS were already applied by allocateWorld
+        if(current_word=="ROWS:"||current_word=="COLS:")
         {
-            file>>number_rows;
-        }
-        else if(current_word=="COLS:")
-        {
-            file>>number_column;
+            int size;
+            file>>size;
         }
         else if(current_word=="SEED:")
         {
-            file>>levelSeed;
+            file>>ctx.levelSeed;
         }
         else if(current_word=="WEATHER:")
         {
             string weather_code;
             file>>weather_code;
-            if(weather_code=="RAIN")      weather_type = weather_rain;
-            else if (weather_code=="FOG")  weather_type = weather_fog;
-            else weather_type = weather_normal;
+            if(weather_code=="RAIN")      ctx.weather_type = weather_rain;
+            else if (weather_code=="FOG")  ctx.weather_type = weather_fog;
+            else ctx.weather_type = weather_normal;
         }
 
         //Map reading
@@ -85,7 +215,7 @@ bool loadLevelFile(string filename)
             string dummy;
             getline(file, dummy); //Remove rest of the line
 
-            for (int row=0;row<number_rows;row++)
+            for (int row=0;row<ctx.number_rows;row++)
             {
                 string line;
                 if(!getline(file,line))
@@ -131,23 +261,23 @@ bool loadLevelFile(string filename)
                 }
 
                 //Copy characters from map to grid
-                for(int c=0;c<number_column;c++)
+                for(int c=0;c<ctx.number_column;c++)
                 {
                     if(c<length)
                     {
                         //Avoid misprinting track and space
                         if(line[c]!='\r'&&line[c]!=' ')
                         {
-                            grid[row][c]=line[c];
+                            ctx.grid[row][c]=line[c];
                         }
                         else
                         {
-                            grid[row][c]=space;
+                            ctx.grid[row][c]=space;
                         }
                     }
                     else
                     {
-                        grid[row][c]=space;
+                        ctx.grid[row][c]=space;
                     }
                 }
             }
@@ -169,31 +299,52 @@ bool loadLevelFile(string filename)
                     break;
                 }
 
-                int index=numSwitches;
-                switchLetter[index]=nextWord[0];
+                //Entry errors point at the line of the switch letter
+                streamoff entryAt=file.tellg();
+                if(nextWord.size()!=1||nextWord[0]<start_switch||nextWord[0]>end_switch)
+                {
+                    return failLoad(error,filename,lineAt(filename,entryAt),"Switch letter must be A-Z, got \""+nextWord+"\"");
+                }
+
+                int index=ctx.numSwitches;
+                if(index>=maximum_switches)
+                {
+                    //Only A-Z can appear on the map
+                    string skipLine;
+                    getline(file,skipLine);
+                    continue;
+                }
+                ctx.switchLetter[index]=nextWord[0];
 
                 string modeStr;
                 file>>modeStr;
                 //0 for Per dir and 1 for global
                 if(modeStr=="PER_DIR")
-                    switchMode[index]=0;
+                    ctx.switchMode[index]=0;
+                else if(modeStr=="GLOBAL")
+                    ctx.switchMode[index]=1;
                 else
-                    switchMode[index]=1;
+                    return failLoad(error,filename,lineAt(filename,entryAt),"Switch mode must be PER_DIR or GLOBAL");
 
-                file>>switchState[index];
+                file>>ctx.switchState[index];
 
                 for(int k=0;k<4;k++)
                 {
-                    file>>switchK[index][k];
-                    switchCounter[index][k]=0;
+                    file>>ctx.switchK[index][k];
+                    ctx.switchCounter[index][k]=0;
                 }
 
                 //Remove extralines
                 string skip1, skip2;
                 file>>skip1>>skip2;
+                if(!file)
+                {
+                    return failLoad(error,filename,lineAt(filename,entryAt),
+                                    "Switch entry needs LETTER MODE STATE K K K K and two state names");
+                }
 
-                switchFlipped[index]=0;
-                numSwitches++;
+                ctx.switchFlipped[index]=0;
+                ctx.numSwitches++;
             }
         }
 
@@ -201,19 +352,30 @@ bool loadLevelFile(string filename)
         else if(current_word=="TRAINS:")
         {
             int rawRow;
-            while (file>>spawnTick[num_spawn])
+            while (ctx.num_spawn<ctx.trainCapacity&&file>>ctx.spawnTick[ctx.num_spawn])
             {
-                file>>spawnn_Column[num_spawn];
+                streamoff entryAt=file.tellg();
+                file>>ctx.spawnn_Column[ctx.num_spawn];
                 file>>rawRow;
-                file>>spawnDirection[num_spawn];
-                file>>spawnColor[num_spawn];
+                file>>ctx.spawnDirection[ctx.num_spawn];
+                file>>ctx.spawnColor[ctx.num_spawn];
+                if(!file)
+                {
+                    return failLoad(error,filename,lineAt(filename,entryAt),
+                                    "Train entry needs 5 numbers: tick column row direction color");
+                }
 
                 //Store raw row
-                spawnn_Row[num_spawn] = rawRow;
+                ctx.spawnn_Row[ctx.num_spawn] = rawRow;
 
                 //Add actual train id
-                spawnTrainID[num_spawn] = -1;
-                num_spawn++;
+                ctx.spawnTrainID[ctx.num_spawn] = -1;
+                ctx.num_spawn++;
+            }
+            //The list ends at the end of the file, not at other text
+            if(file.fail()&&!file.eof())
+            {
+                return failLoad(error,filename,lineAt(filename,failedAt(file)),"Expected a number in TRAINS:");
             }
         }
     }
@@ -224,31 +386,32 @@ bool loadLevelFile(string filename)
     // DESTINATIONS (D on the map)
     // ------------------------------------------------------------------------
     int destination_Count=0;
-    int destRows[max_trains];
-    int destCols[max_trains];
+    vector<int> destRows;
+    vector<int> destCols;
 
-    for(int r=0;r<number_rows;r++)
+    for(int r=0;r<ctx.number_rows;r++)
     {
-        for(int c=0;c<number_column;c++)
+        for(int c=0;c<ctx.number_column;c++)
         {
-            if(grid[r][c]=='D')
+            //Keep an untouched copy for resetting safety tiles
+            ctx.originalGrid[r][c]=ctx.grid[r][c];
+            if(ctx.grid[r][c]=='D')
             {
-                destRows[destination_Count]=r;
-                destCols[destination_Count]=c;
+                destRows.push_back(r);
+                destCols.push_back(c);
                 destination_Count++;
-                if(destination_Count>=max_trains) break;
             }
         }
-        if(destination_Count>=max_trains) break;
     }
+    buildTileInfo(ctx);
 
     // ------------------------------------------------------------------------
     // IDENTIFYING SPAWN POINTS (S on the map)
     // ------------------------------------------------------------------------
-    for(int i=0;i<num_spawn;i++)
+    for(int i=0;i<ctx.num_spawn;i++)
     {
-        int originalRow=spawnn_Row[i];
-        int originalColumn=spawnn_Column[i];
+        int originalRow=ctx.spawnn_Row[i];
+        int originalColumn=ctx.spawnn_Column[i];
         bool fixed=false;
         int search_row[8];
         int searchColumn[8];
@@ -277,13 +440,13 @@ bool loadLevelFile(string filename)
         {
             int mapRow=search_row[k];
             int mapColumn=searchColumn[k];
-            if(mapRow<0||mapRow>=number_rows||mapColumn<0||mapColumn>=number_column)
+            if(mapRow<0||mapRow>=ctx.number_rows||mapColumn<0||mapColumn>=ctx.number_column)
                 continue;
 
-            if(grid[mapRow][mapColumn]=='S')
+            if(ctx.grid[mapRow][mapColumn]=='S')
             {
-                spawnn_Row[i]=mapRow;
-                spawnn_Column[i]=mapColumn;
+                ctx.spawnn_Row[i]=mapRow;
+                ctx.spawnn_Column[i]=mapColumn;
                 fixed=true;
                 break;
             }
@@ -296,44 +459,42 @@ bool loadLevelFile(string filename)
             int safe_Col=originalColumn-1;
             if (safe_row<0)safe_row=0;
             if (safe_Col< 0)safe_Col=0;
-            if (safe_row>=number_rows)safe_row=0;
-            if (safe_Col>=number_column)safe_Col=0;
-            spawnn_Row[i]=safe_row;
-            spawnn_Column[i]=safe_Col;
+            if (safe_row>=ctx.number_rows)safe_row=0;
+            if (safe_Col>=ctx.number_column)safe_Col=0;
+            ctx.spawnn_Row[i]=safe_row;
+            ctx.spawnn_Column[i]=safe_Col;
         }
     }
 
     //Map spawn points to track S tiles
     int foundstart_count=0;
-    int sRows[max_trains];
-    int sCols[max_trains];
+    vector<int> sRows;
+    vector<int> sCols;
 
-    for(int r=0;r<number_rows;r++)
+    for(int r=0;r<ctx.number_rows;r++)
     {
-        for (int c=0;c<number_column;c++)
+        for (int c=0;c<ctx.number_column;c++)
         {
-            if(grid[r][c]=='S')
+            if(ctx.grid[r][c]=='S')
             {
-                sRows[foundstart_count]=r;
-                sCols[foundstart_count]=c;
+                sRows.push_back(r);
+                sCols.push_back(c);
                 foundstart_count++;
-                if (foundstart_count >= max_trains) break;
             }
         }
-        if (foundstart_count >= max_trains) break;
     }
 
     if (foundstart_count>0)
     {
         //Check if spawn location and S tile dont match
         bool needFallback = false;
-        for (int i = 0; i < num_spawn; i++)
+        for (int i = 0; i < ctx.num_spawn; i++)
         {
-            int mapRow = spawnn_Row[i];
-            int mapColumn = spawnn_Column[i];
-            if (mapRow < 0 || mapRow >= number_rows ||
-                mapColumn < 0 || mapColumn >= number_column ||
-                grid[mapRow][mapColumn] != 'S')
+            int mapRow = ctx.spawnn_Row[i];
+            int mapColumn = ctx.spawnn_Column[i];
+            if (mapRow < 0 || mapRow >= ctx.number_rows ||
+                mapColumn < 0 || mapColumn >= ctx.number_column ||
+                ctx.grid[mapRow][mapColumn] != 'S')
             {
                 needFallback = true;
                 break;
@@ -342,11 +503,11 @@ bool loadLevelFile(string filename)
         //Map all spawn points to S tiles
         if (needFallback)
         {
-            for (int i = 0; i < num_spawn; i++)
+            for (int i = 0; i < ctx.num_spawn; i++)
             {
                 int idx=i%foundstart_count;
-                spawnn_Row[i]=sRows[idx];
-                spawnn_Column[i]=sCols[idx];
+                ctx.spawnn_Row[i]=sRows[idx];
+                ctx.spawnn_Column[i]=sCols[idx];
             }
         }
     }
@@ -354,129 +515,468 @@ bool loadLevelFile(string filename)
     // ------------------------------------------------------------------------
     // ASSIGN DESTINATIONS TO SPAWNS
     // ------------------------------------------------------------------------
-    for (int i = 0; i < num_spawn; i++)
+    for (int i = 0; i < ctx.num_spawn; i++)
     {
         if (destination_Count > 0)
         {
             //Assign destinations
-            destinationRow[i]     = destRows[i % destination_Count];
-            destinationColumn[i]  = destCols[i % destination_Count];
-            destinationTrainID[i] = i;
-            numDest++;
+            ctx.destinationRow[i]     = destRows[i % destination_Count];
+            ctx.destinationColumn[i]  = destCols[i % destination_Count];
+            ctx.destinationTrainID[i] = i;
+            ctx.numDest++;
         }
     }
 
-    cout << "Level loaded: " << filename << endl;
+    // ------------------------------------------------------------------------
+    // LOOKUP TABLES FOR SPAWNS AND DESTINATIONS
+    // ------------------------------------------------------------------------
+    //Flag spawn/destination tiles so position checks don't scan the lists
+    for (int i = 0; i < ctx.num_spawn; i++)
+    {
+        if (isInBounds(ctx, ctx.spawnn_Row[i], ctx.spawnn_Column[i]))
+            ctx.tileInfo[ctx.spawnn_Row[i]*ctx.number_column+ctx.spawnn_Column[i]].pointMask |= point_spawn;
+    }
+    for (int d = ctx.numDest-1; d >= 0; d--)
+    {
+        if (isInBounds(ctx, ctx.destinationRow[d], ctx.destinationColumn[d]))
+            ctx.tileInfo[ctx.destinationRow[d]*ctx.number_column+ctx.destinationColumn[d]].pointMask |= point_destination;
+        //First destination of each train (walking backwards leaves the lowest d)
+        int owner = ctx.destinationTrainID[d];
+        if (owner >= 0 && owner < ctx.trainCapacity)
+            ctx.trainDestination[owner] = d;
+    }
+
+    //Track distances to the destinations (falls back to Manhattan if skipped)
+    buildRouteField(ctx);
+    //Straight runs for the segment fast path in moveAllTrains
+    buildTrackGraph(ctx);
+    //Random stream for this level (SEED 0 keeps the current one)
+    if(ctx.levelSeed!=0) seedRandom(ctx, ctx.levelSeed);
+
+    if(!error) cout << "Level loaded: " << filename << endl;
     return true;
 }
 
 // ----------------------------------------------------------------------------
 // LOGGING FUNCTIONS
 // ----------------------------------------------------------------------------
+// Each log file stays open for the whole run. Rows are formatted into a
+// buffer that is written out when nearly full and when writeMetrics closes
+// the files. Binary sinks (trace_format.h) stage one chunk column by column
+// and patch the header row count and tick range on close. In async mode the
+// rows are formatted on a writer thread instead (see ASYNC LOGGING). All of
+// this state lives in the run's TraceLog (io.h).
+// ----------------------------------------------------------------------------
+
+// Longest row any logger appends (six integers and separators)
+static const size_t log_row_bytes = 96;
 
-void initializeLogFiles()
+static void flushLogSink(LogSink &sink)
 {
-    ofstream f1("trace.csv");
-    if (f1.is_open())
-    {
-        f1 << "time_Tick,Id_train,X_cord,Y_cord,Direction,State" << endl;
-        f1.close();
+    if (!sink.file || sink.used == 0) return;
+    if (!sink.binary) {
+        fwrite(sink.buffer, 1, sink.used, sink.file);
+    } else {
+        // Staged chunk: write the used part of each column
+        const char *column = sink.buffer;
+        for (uint32_t c = 0; c < sink.header.columns; c++) {
+            fwrite(column, sink.header.columnWidth[c], sink.used, sink.file);
+            column += (size_t)trace_chunk_rows * sink.header.columnWidth[c];
+        }
     }
+    sink.used = 0;
+}
 
-    ofstream f2("switches.csv");
-    if (f2.is_open())
-    {
-        f2 << "time_Tick,Switch,mode,State" << endl;
-        f2.close();
+static void closeLogSink(LogSink &sink)
+{
+    if (!sink.file) return;
+    flushLogSink(sink);
+    if (sink.binary) {
+        fseek(sink.file, 0, SEEK_SET);
+        fwrite(&sink.header, sizeof(sink.header), 1, sink.file);
     }
+    fclose(sink.file);
+    free(sink.buffer);
+    sink.file = 0;
+    sink.buffer = 0;
+}
 
-    ofstream f3("signals.csv");
-    if (f3.is_open())
-    {
-        f3 << "time_Tick,Switch,Signal" << endl;
-        f3.close();
+static void openLogSink(LogSink &sink, const char *filename, uint32_t table)
+{
+    closeLogSink(sink);
+    sink.file = fopen(filename, "w");
+    if (!sink.file) return;
+    sink.buffer = (char*)malloc(log_buffer_bytes);
+    if (!sink.buffer) {
+        fclose(sink.file);
+        sink.file = 0;
+        return;
     }
+    sink.used = 0;
+    sink.binary = false;
+    fputs(trace_csv_headers[table], sink.file);
 }
 
-void logTrainTrace()
+static void openBinarySink(LogSink &sink, const char *filename, uint32_t table,
+                           const SimulationContext &ctx, int keyframeTicks)
 {
-    ofstream file("trace.csv", ios::app);
-    if (file.is_open())
-    {
-        for (int i=0;i<numOf_trains;i++)
-        {
-            if (trainRow[i] != -1)
-            {
-                file <<currentTick<<","
-                     <<i << ","
-                     <<trainColumn[i]<<","
-                     <<trainRow[i]<<","
-                     <<trainDirection[i]<<","
-                     <<trainWait[i]<<endl;
+    closeLogSink(sink);
+    sink.file = fopen(filename, "wb");
+    if (!sink.file) return;
+
+    TraceHeader &header = sink.header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, trace_magic, sizeof(header.magic));
+    header.version   = trace_version;
+    header.table     = table;
+    header.levelHash = ctx.levelHash;
+    header.seed      = ctx.levelSeed;
+    header.firstTick = -1;
+    header.lastTick  = -1;
+    header.chunkRows = trace_chunk_rows;
+    header.columns   = trace_table_columns[table];
+    header.keyframeTicks = (table == trace_table_trains) ? 0 : keyframeTicks;
+    for (int c = 0; c < trace_table_columns[table]; c++) {
+        header.columnWidth[c] = trace_column_widths[table][c];
+    }
+
+    sink.buffer = (char*)malloc(trace_chunk_rows * traceRowBytes(header));
+    if (!sink.buffer) {
+        fclose(sink.file);
+        sink.file = 0;
+        return;
+    }
+    sink.used = 0;
+    sink.binary = true;
+    // Placeholder until the row count and tick range are known
+    fwrite(&header, sizeof(header), 1, sink.file);
+}
+
+// Stage one row of a binary table (values[0] is the tick)
+static void appendBinaryRow(LogSink &sink, const int *values)
+{
+    TraceHeader &header = sink.header;
+    if (header.rows == 0) header.firstTick = values[0];
+    header.lastTick = values[0];
+    header.rows++;
+
+    char *column = sink.buffer;
+    for (uint32_t c = 0; c < header.columns; c++) {
+        uint32_t width = header.columnWidth[c];
+        char *at = column + sink.used * width;
+        if (width == 1)      { int8_t v  = (int8_t)values[c];  memcpy(at, &v, 1); }
+        else if (width == 2) { int16_t v = (int16_t)values[c]; memcpy(at, &v, 2); }
+        else                 { int32_t v = (int32_t)values[c]; memcpy(at, &v, 4); }
+        column += (size_t)trace_chunk_rows * width;
+    }
+    if (++sink.used == trace_chunk_rows) flushLogSink(sink);
+}
+
+// Make room for one more CSV row
+static char *reserveRow(LogSink &sink)
+{
+    if (sink.used + log_row_bytes > log_buffer_bytes) flushLogSink(sink);
+    return sink.buffer + sink.used;
+}
+
+static char *appendInt(char *out, int value)
+{
+    char digits[12];
+    int count = 0;
+    unsigned int magnitude = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+    do {
+        digits[count++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+    if (value < 0) *out++ = '-';
+    while (count > 0) *out++ = digits[--count];
+    return out;
+}
+
+static char *appendText(char *out, const char *text)
+{
+    while (*text) *out++ = *text++;
+    return out;
+}
+
+// ----------------------------------------------------------------------------
+// Write one row of `table` to its sink (values[0] is the tick).
+// ----------------------------------------------------------------------------
+static void writeRow(TraceLog &log, int table, const int *values)
+{
+    LogSink &sink = log.sinks[table];
+    if (sink.binary) {
+        appendBinaryRow(sink, values);
+        return;
+    }
+
+    char *out = reserveRow(sink);
+    out = appendInt(out, values[0]);  *out++ = ',';
+    if (table == (int)trace_table_trains) {
+        out = appendInt(out, values[1]);  *out++ = ',';
+        out = appendInt(out, values[2]);  *out++ = ',';
+        out = appendInt(out, values[3]);  *out++ = ',';
+        out = appendInt(out, values[4]);  *out++ = ',';
+        out = appendInt(out, values[5]);
+    } else if (table == (int)trace_table_switches) {
+        *out++ = (char)values[1];         *out++ = ',';
+        out = appendInt(out, values[2]);  *out++ = ',';
+        out = appendInt(out, values[3]);
+    } else {
+        //Convert signal number to string
+        *out++ = (char)values[1];         *out++ = ',';
+        out = appendText(out, traceSignalName(values[2]));
+    }
+    *out++ = '\n';
+    sink.used = out - sink.buffer;
+}
+
+// Extend a binary table's tick range to `tick` (delta tables can log a tick
+// without any rows)
+static void noteTick(TraceLog &log, int table, int tick)
+{
+    LogSink &sink = log.sinks[table];
+    if (!sink.binary) return;
+    if (sink.header.firstTick == -1) sink.header.firstTick = tick;
+    sink.header.lastTick = tick;
+}
+
+// ============================================================================
+// ASYNC LOGGING
+// ============================================================================
+// The tick loop only copies rows into a single-producer single-consumer ring;
+// a writer thread formats them into the sinks. When the ring is full the tick
+// loop waits for the writer (back-pressure) rather than dropping rows.
+// writeMetrics drains the ring and joins the writer before closing the files.
+// ============================================================================
+static const int log_tick_mark = trace_tables;
+
+// Records the writer formats before publishing its progress
+static const size_t log_writer_batch = 256;
+
+static void runLogWriter(TraceLog *log)
+{
+    LogRing &ring = log->ring;
+    while (true) {
+        size_t head = ring.head.load(memory_order_relaxed);
+        size_t tail = ring.tail.load(memory_order_acquire);
+        if (head == tail) {
+            //Rows pushed before the stop request are visible once it is
+            if (ring.stopping.load(memory_order_acquire)) {
+                if (ring.tail.load(memory_order_acquire) == head) break;
+                continue;
             }
+            this_thread::sleep_for(chrono::microseconds(100));
+            continue;
         }
-        file.close();
+        if (tail - head > log_writer_batch) tail = head + log_writer_batch;
+        for (; head != tail; head++) {
+            const LogRecord &record = ring.records[head & (log_ring_records - 1)];
+            if (record.table >= log_tick_mark) noteTick(*log, record.table - log_tick_mark, record.values[0]);
+            else writeRow(*log, record.table, record.values);
+        }
+        ring.head.store(head, memory_order_release);
     }
 }
 
-void logSwitchState()
+static void pushRecord(LogRing &ring, int table, const int *values, int count)
 {
-    ofstream file("switches.csv", ios::app);
-    if (file.is_open())
+    size_t tail = ring.tail.load(memory_order_relaxed);
+    //Only look at the writer's position when the ring seems full
+    while (tail - ring.headSeen >= log_ring_records) {
+        ring.headSeen = ring.head.load(memory_order_acquire);
+        if (tail - ring.headSeen >= log_ring_records) this_thread::yield();
+    }
+    LogRecord &record = ring.records[tail & (log_ring_records - 1)];
+    record.table = table;
+    memcpy(record.values, values, count * sizeof(int));
+    ring.tail.store(tail + 1, memory_order_release);
+}
+
+// Drain the ring and stop the writer (no-op when not running)
+static void stopAsyncLogging(TraceLog &log)
+{
+    LogRing &ring = log.ring;
+    if (!ring.running) return;
+    ring.stopping.store(true, memory_order_release);
+    ring.writer.join();
+    delete[] ring.records;
+    ring.records = 0;
+    ring.running = false;
+}
+
+void startAsyncLogging(TraceLog &log)
+{
+    LogRing &ring = log.ring;
+    if (ring.running) return;
+    ring.records = new LogRecord[log_ring_records];
+    ring.head.store(0, memory_order_relaxed);
+    ring.tail.store(0, memory_order_relaxed);
+    ring.headSeen = 0;
+    ring.stopping.store(false, memory_order_relaxed);
+    ring.running = true;
+    ring.writer = thread(runLogWriter, &log);
+}
+
+// Hand a row to the writer thread, or write it here when not in async mode
+static void emitRow(TraceLog &log, int table, const int *values, int count)
+{
+    if (log.ring.running) pushRecord(log.ring, table, values, count);
+    else writeRow(log, table, values);
+}
+
+static void emitTickMark(TraceLog &log, int table, int tick)
+{
+    if (log.ring.running) pushRecord(log.ring, log_tick_mark + table, &tick, 1);
+    else noteTick(log, table, tick);
+}
+
+// ----------------------------------------------------------------------------
+// DELTA LOGGING
+// ----------------------------------------------------------------------------
+void setDeltaLogging(TraceLog &log, int keyframeTicks)
+{
+    log.keyframeTicks = keyframeTicks > 0 ? keyframeTicks : 0;
+}
+
+// Does `table` log every switch on this tick? (Records the keyframe.)
+static bool isKeyframe(TraceLog &log, int table, int tick)
+{
+    if (log.keyframeTicks == 0) return true;
+    if (log.lastKeyframe[table] != -1 && tick - log.lastKeyframe[table] < log.keyframeTicks) return false;
+    log.lastKeyframe[table] = tick;
+    return true;
+}
+
+static void resetDeltaLogging(TraceLog &log)
+{
+    for (int t = 0; t < trace_tables; t++) log.lastKeyframe[t] = -1;
+}
+
+// ----------------------------------------------------------------------------
+// TRACE LOG
+// ----------------------------------------------------------------------------
+TraceLog::TraceLog()
+{
+    for (int t = 0; t < trace_tables; t++) {
+        sinks[t].file = 0;
+        sinks[t].buffer = 0;
+        sinks[t].used = 0;
+        sinks[t].binary = false;
+    }
+    ring.records = 0;
+    ring.head.store(0, memory_order_relaxed);
+    ring.tail.store(0, memory_order_relaxed);
+    ring.headSeen = 0;
+    ring.stopping.store(false, memory_order_relaxed);
+    ring.running = false;
+    keyframeTicks = 0;
+    resetDeltaLogging(*this);
+}
+
+TraceLog::~TraceLog()
+{
+    stopAsyncLogging(*this);
+    for (int t = 0; t < trace_tables; t++) closeLogSink(sinks[t]);
+}
+
+// File `name` inside the log's directory
+static string logPath(const TraceLog &log, const char *name)
+{
+    if (log.directory.empty()) return name;
+    return log.directory + "/" + name;
+}
+
+void initializeLogFiles(TraceLog &log, const string &directory)
+{
+    stopAsyncLogging(log);
+    resetDeltaLogging(log);
+    log.directory = directory;
+    openLogSink(log.sinks[trace_table_trains],   logPath(log, "trace.csv").c_str(),    trace_table_trains);
+    openLogSink(log.sinks[trace_table_switches], logPath(log, "switches.csv").c_str(), trace_table_switches);
+    openLogSink(log.sinks[trace_table_signals],  logPath(log, "signals.csv").c_str(),  trace_table_signals);
+}
+
+void initializeBinaryLogFiles(TraceLog &log, const SimulationContext &ctx, const string &directory)
+{
+    stopAsyncLogging(log);
+    resetDeltaLogging(log);
+    log.directory = directory;
+    openBinarySink(log.sinks[trace_table_trains],   logPath(log, "trace.bin").c_str(),
+                   trace_table_trains,   ctx, log.keyframeTicks);
+    openBinarySink(log.sinks[trace_table_switches], logPath(log, "switches.bin").c_str(),
+                   trace_table_switches, ctx, log.keyframeTicks);
+    openBinarySink(log.sinks[trace_table_signals],  logPath(log, "signals.bin").c_str(),
+                   trace_table_signals,  ctx, log.keyframeTicks);
+}
+
+void logTrainTrace(TraceLog &log, const SimulationContext &ctx)
+{
+    if (!log.sinks[trace_table_trains].file) return;
+    for (int i=0;i<ctx.numOf_trains;i++)
     {
-        for (int i = 0; i < numSwitches; i++)
+        if (ctx.trainRow[i] != -1)
         {
-            file<<currentTick<<","
-                 <<switchLetter[i]<<","
-                 <<switchMode[i]<<","
-                 <<switchState[i]<<endl;
+            int values[6] = { ctx.currentTick, i, ctx.trainColumn[i], ctx.trainRow[i],
+                              ctx.trainDirection[i], ctx.trainWait[i] };
+            emitRow(log, trace_table_trains, values, 6);
         }
-        file.close();
     }
 }
 
+void logSwitchState(TraceLog &log, const SimulationContext &ctx)
+{
+    if (!log.sinks[trace_table_switches].file) return;
+    bool keyframe = isKeyframe(log, trace_table_switches, ctx.currentTick);
+    for (int i = 0; i < ctx.numSwitches; i++)
+    {
+        if (!keyframe && ctx.switchMode[i] == log.loggedSwitchMode[i] &&
+            ctx.switchState[i] == log.loggedSwitchState[i]) continue;
+        log.loggedSwitchMode[i]  = ctx.switchMode[i];
+        log.loggedSwitchState[i] = ctx.switchState[i];
+
+        int values[4] = { ctx.currentTick, ctx.switchLetter[i],
+                          ctx.switchMode[i], ctx.switchState[i] };
+        emitRow(log, trace_table_switches, values, 4);
+    }
+    if (log.keyframeTicks > 0) emitTickMark(log, trace_table_switches, ctx.currentTick);
+}
+
 // ============================================================================
 // Signal State Logging with Actual Colors
 // ============================================================================
-void logSignalState()
+void logSignalState(TraceLog &log, const SimulationContext &ctx)
 {
-    ofstream file("signals.csv", ios::app);
-    if (file.is_open())
+    if (!log.sinks[trace_table_signals].file) return;
+    bool keyframe = isKeyframe(log, trace_table_signals, ctx.currentTick);
+    for(int i=0;i<ctx.numSwitches;i++)
     {
-        for(int i=0;i<numSwitches;i++)
-        {
-            //Convert signal number to string
-            string color;
-            if (switchSignal[i]==signal_green)
-                color="GREEN";
-            else if(switchSignal[i]==signal_yellow)
-                color="YELLOW";
-            else if (switchSignal[i]==sigal_red)
-                color="RED";
-            else
-                color="GREEN";  //Return to Default
-            
-            file<<currentTick<<","
-                 <<switchLetter[i]<<","
-                 <<color<<endl;
-        }
-        file.close();
+        if (!keyframe && ctx.switchSignal[i] == log.loggedSignal[i]) continue;
+        log.loggedSignal[i] = ctx.switchSignal[i];
+
+        int values[3] = { ctx.currentTick, ctx.switchLetter[i], ctx.switchSignal[i] };
+        emitRow(log, trace_table_signals, values, 3);
     }
+    if (log.keyframeTicks > 0) emitTickMark(log, trace_table_signals, ctx.currentTick);
 }
 
-void writeMetrics()
+void writeMetrics(TraceLog &log, const SimulationContext &ctx)
 {
-    ofstream file("metrics.txt");
+    //End of run: drain the writer thread, then write out and close the traces
+    stopAsyncLogging(log);
+    for (int t = 0; t < trace_tables; t++) closeLogSink(log.sinks[t]);
+
+    ofstream file(logPath(log, "metrics.txt").c_str());
     if (file.is_open())
     {
         file<<"SIMULATION REPORT"<<endl;
         file<<"-----------------"<<endl;
-        file<<"Total Ticks: "<<currentTick<<endl;
-        file<<"Trains Reached to Destination: "<<trainsReached<<endl;
-        file<<"Trains Crashed: "<<crashed_trains<<endl;
-        file<<"Total Waiting Time: "<<totalWaitTicks<<endl;
-        file<<"Total Energy Used: "<<T_energy<<endl;
-        file<<"Switch Flips: "<<switchFlips<<endl;
+        file<<"Total Ticks: "<<ctx.currentTick<<endl;
+        file<<"Trains Reached to Destination: "<<ctx.trainsReached<<endl;
+        file<<"Trains Crashed: "<<ctx.crashed_trains<<endl;
+        file<<"Total Waiting Time: "<<ctx.totalWaitTicks<<endl;
+        file<<"Total Energy Used: "<<ctx.T_energy<<endl;
+        file<<"Switch Flips: "<<ctx.switchFlips<<endl;
         file.close();
     }
-}
\ No newline at end of file
+}
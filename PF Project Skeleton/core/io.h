@@ -1,32 +1,113 @@
 #ifndef IO_H
 #define IO_H
+#include "trace_format.h"
+#include <atomic>
+#include <cstdio>
 #include<string>
+#include <thread>
 
 // ============================================================================
 // IO.H - Level I/O and logging
 // ============================================================================
 
+struct SimulationContext;
+
 // ----------------------------------------------------------------------------
 // LEVEL LOADING
 // ----------------------------------------------------------------------------
-// Load a .lvl file.
-bool loadLevelFile(std::string filename);
+// What went wrong loading a level (line is 0 when not tied to one).
+struct LevelLoadError {
+    std::string file;
+    int line;
+    std::string message;
+};
+
+// Load a .lvl file. Problems are printed, or with `error` stored there
+// instead (nothing is printed, so many levels can load side by side).
+bool loadLevelFile(SimulationContext &ctx, std::string filename, LevelLoadError *error = 0);
+
+// FNV-1a hash of a file's bytes, or 0 if it cannot be read.
+unsigned long long hashLevelFile(const std::string &filename);
 // ----------------------------------------------------------------------------
 // LOGGING
 // ----------------------------------------------------------------------------
-// Create/clear log files.
-void initializeLogFiles();
+// One table's output file. Rows are batched in `buffer` (see LOGGING
+// FUNCTIONS in io.cpp).
+struct LogSink {
+    FILE *file;
+    char *buffer;
+    size_t used;                // CSV: bytes buffered; binary: rows staged
+    bool binary;
+    TraceHeader header;         // Binary only
+};
+
+// One row queued for the async writer thread.
+struct LogRecord {
+    int table;                          // log_tick_mark + table for noteTick
+    int values[7];                      // Widest table uses 6
+};
+
+// Single-producer single-consumer ring between the tick loop and the writer.
+struct LogRing {
+    LogRecord *records;                 // log_ring_records slots
+    alignas(64) std::atomic<size_t> head;   // Next record to format (writer)
+    alignas(64) std::atomic<size_t> tail;   // Next slot to fill (tick loop)
+    size_t headSeen;                    // Tick loop's last read of head
+    std::atomic<bool> stopping;
+    std::thread writer;
+    bool running;
+};
+
+// Everything one run's traces need: the open files, the async ring and the
+// delta bookkeeping. Each run that traces owns its own TraceLog, so runs on
+// different threads can trace at once (each into its own directory).
+struct TraceLog {
+    LogSink sinks[trace_tables];        // One sink per table (trace_table_trains, ...)
+    LogRing ring;
+    std::string directory;              // Where the files go ("" = working directory)
+
+    // Delta logging (switch and signal tables): see setDeltaLogging
+    int keyframeTicks;
+    int lastKeyframe[trace_tables];     // -1 until the first one
+    int loggedSwitchMode[maximum_switches];
+    int loggedSwitchState[maximum_switches];
+    int loggedSignal[maximum_switches];
+
+    TraceLog();
+    ~TraceLog();                        // Stops the writer and closes the files
+    TraceLog(const TraceLog&)=delete;
+    TraceLog& operator=(const TraceLog&)=delete;
+};
+
+// Create/clear log files in `directory` ("" = working directory) and keep
+// them open for the run.
+void initializeLogFiles(TraceLog &log, const std::string &directory = "");
+
+// Same, writing the binary trace.bin/switches.bin/signals.bin instead
+// (layout in trace_format.h; tools/trace_to_csv.cpp converts back to CSV).
+void initializeBinaryLogFiles(TraceLog &log, const SimulationContext &ctx,
+                              const std::string &directory = "");
+
+// Log switches and signals as changes only, with every switch repeated every
+// `keyframeTicks` ticks (0 = every switch every tick, the default). Call
+// before initializeLogFiles/initializeBinaryLogFiles.
+void setDeltaLogging(TraceLog &log, int keyframeTicks);
+
+// Format and write rows on a background thread from now on; the loggers
+// below then only queue rows. writeMetrics drains and stops the thread.
+void startAsyncLogging(TraceLog &log);
 
 // Append train movement to trace.csv.
-void logTrainTrace();
+void logTrainTrace(TraceLog &log, const SimulationContext &ctx);
 
 // Append switch state to switches.csv.
-void logSwitchState();
+void logSwitchState(TraceLog &log, const SimulationContext &ctx);
 
 // Append signal state to signals.csv.
-void logSignalState();
+void logSignalState(TraceLog &log, const SimulationContext &ctx);
 
-// Write final metrics to metrics.txt.
-void writeMetrics();
+// Flush and close the log files, then write final metrics to metrics.txt
+// in the log's directory.
+void writeMetrics(TraceLog &log, const SimulationContext &ctx);
 
 #endif
@@ -0,0 +1,318 @@
+#include "level_cache.h"
+#include "simulation_state.h"
+#include "io.h"
+#include "routing.h"
+#include "track_graph.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+// ============================================================================
+// LEVEL_CACHE.CPP - Compiled levels
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// FILE LAYOUT
+// ----------------------------------------------------------------------------
+// Header, then each section at an 8-byte aligned offset named in the header.
+// Values are in host byte order; the cache is local to the machine.
+// ----------------------------------------------------------------------------
+static const char compiled_magic[8]={'S','B','L','E','V','E','L','\0'};
+static const uint32_t compiled_version=1;
+
+struct CompiledHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t tileBytes;             // sizeof(TileInfo) when written
+    uint64_t sourceHash;            // FNV-1a of the .lvl (hashLevelFile)
+    int32_t rows;
+    int32_t columns;
+    int32_t trainCapacity;
+    int32_t levelSeed;
+    int32_t weather;
+    int32_t numSwitches;
+    int32_t numSpawns;
+    int32_t numDestinations;
+    uint64_t routeStates;           // Distance field entries, 0 if not stored
+    uint64_t gridOffset;            // rows*columns chars
+    uint64_t tileOffset;            // rows*columns TileInfo
+    uint64_t switchOffset;          // numSwitches CompiledSwitch
+    uint64_t spawnOffset;           // numSpawns CompiledSpawn
+    uint64_t destinationOffset;     // numDestinations CompiledDestination
+    uint64_t trainDestinationOffset;// trainCapacity int32
+    uint64_t routeOffset;           // routeStates uint16
+    uint64_t fileBytes;
+};
+
+struct CompiledSwitch {
+    char letter;
+    int8_t mode;
+    int8_t reserved[2];
+    int32_t state;
+    int32_t k[4];
+};
+
+struct CompiledSpawn {
+    int32_t tick;
+    int32_t row;
+    int32_t column;
+    int32_t direction;
+    int32_t color;
+};
+
+struct CompiledDestination {
+    int32_t row;
+    int32_t column;
+    int32_t trainID;
+};
+
+static uint64_t alignSection(uint64_t offset) {
+    return (offset + 7) & ~(uint64_t)7;
+}
+
+// Lay out the sections for the counts in `header` and fill in the offsets
+static void layoutSections(CompiledHeader &header) {
+    uint64_t cells = (uint64_t)header.rows * (uint64_t)header.columns;
+    uint64_t offset = sizeof(CompiledHeader);
+    header.gridOffset             = offset = alignSection(offset);
+    offset += cells;
+    header.tileOffset             = offset = alignSection(offset);
+    offset += cells * sizeof(TileInfo);
+    header.switchOffset           = offset = alignSection(offset);
+    offset += (uint64_t)header.numSwitches * sizeof(CompiledSwitch);
+    header.spawnOffset            = offset = alignSection(offset);
+    offset += (uint64_t)header.numSpawns * sizeof(CompiledSpawn);
+    header.destinationOffset      = offset = alignSection(offset);
+    offset += (uint64_t)header.numDestinations * sizeof(CompiledDestination);
+    header.trainDestinationOffset = offset = alignSection(offset);
+    offset += (uint64_t)header.trainCapacity * sizeof(int32_t);
+    header.routeOffset            = offset = alignSection(offset);
+    offset += header.routeStates * sizeof(uint16_t);
+    header.fileBytes = offset;
+}
+
+// ----------------------------------------------------------------------------
+// Compile the loaded level into memory.
+// ----------------------------------------------------------------------------
+bool compileLevel(const SimulationContext &ctx, vector<char> &compiled) {
+    CompiledHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, compiled_magic, sizeof(header.magic));
+    header.version         = compiled_version;
+    header.tileBytes       = sizeof(TileInfo);
+    header.sourceHash      = ctx.levelHash;
+    header.rows            = ctx.number_rows;
+    header.columns         = ctx.number_column;
+    header.trainCapacity   = ctx.trainCapacity;
+    header.levelSeed       = ctx.levelSeed;
+    header.weather         = ctx.weather_type;
+    header.numSwitches     = ctx.numSwitches;
+    header.numSpawns       = ctx.num_spawn;
+    header.numDestinations = ctx.numDest;
+    header.routeStates     = ctx.routeField ? (uint64_t)ctx.number_rows * ctx.number_column * 4 : 0;
+    layoutSections(header);
+
+    compiled.assign(header.fileBytes, 0);
+    char *image = &compiled[0];
+    memcpy(image, &header, sizeof(header));
+
+    size_t cells = (size_t)ctx.number_rows * ctx.number_column;
+    for (int r = 0; r < ctx.number_rows; r++) {
+        memcpy(image + header.gridOffset + (size_t)r * ctx.number_column,
+               ctx.originalGrid[r], ctx.number_column);
+    }
+    memcpy(image + header.tileOffset, ctx.tileInfo, cells * sizeof(TileInfo));
+
+    CompiledSwitch *switches = (CompiledSwitch*)(image + header.switchOffset);
+    for (int i = 0; i < ctx.numSwitches; i++) {
+        switches[i].letter = ctx.switchLetter[i];
+        switches[i].mode   = (int8_t)ctx.switchMode[i];
+        switches[i].state  = ctx.switchState[i];
+        for (int k = 0; k < 4; k++) switches[i].k[k] = ctx.switchK[i][k];
+    }
+    CompiledSpawn *spawns = (CompiledSpawn*)(image + header.spawnOffset);
+    for (int i = 0; i < ctx.num_spawn; i++) {
+        spawns[i].tick      = ctx.spawnTick[i];
+        spawns[i].row       = ctx.spawnn_Row[i];
+        spawns[i].column    = ctx.spawnn_Column[i];
+        spawns[i].direction = ctx.spawnDirection[i];
+        spawns[i].color     = ctx.spawnColor[i];
+    }
+    CompiledDestination *destinations = (CompiledDestination*)(image + header.destinationOffset);
+    for (int d = 0; d < ctx.numDest; d++) {
+        destinations[d].row     = ctx.destinationRow[d];
+        destinations[d].column  = ctx.destinationColumn[d];
+        destinations[d].trainID = ctx.destinationTrainID[d];
+    }
+    memcpy(image + header.trainDestinationOffset, ctx.trainDestination,
+           (size_t)ctx.trainCapacity * sizeof(int32_t));
+    if (header.routeStates > 0) {
+        memcpy(image + header.routeOffset, ctx.routeField, header.routeStates * sizeof(uint16_t));
+    }
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Write the loaded level.
+// ----------------------------------------------------------------------------
+bool writeCompiledLevel(const SimulationContext &ctx, const string &path) {
+    vector<char> image;
+    if (!compileLevel(ctx, image)) return false;
+
+    //Write under a temporary name so readers never see half a file
+    string temporary = path + ".tmp" + to_string((long long)getpid());
+    FILE *file = fopen(temporary.c_str(), "wb");
+    bool written = file && fwrite(&image[0], 1, image.size(), file) == image.size();
+    if (file && fclose(file) != 0) written = false;
+    if (written) written = rename(temporary.c_str(), path.c_str()) == 0;
+    if (!written) remove(temporary.c_str());
+    return written;
+}
+
+// ----------------------------------------------------------------------------
+// Check a mapped file before any section is read.
+// ----------------------------------------------------------------------------
+static bool validateCompiled(const CompiledHeader &header, size_t fileBytes,
+                             unsigned long long sourceHash) {
+    if (memcmp(header.magic, compiled_magic, sizeof(header.magic)) != 0) return false;
+    if (header.version != compiled_version || header.tileBytes != sizeof(TileInfo)) return false;
+    if (sourceHash != 0 && header.sourceHash != sourceHash) return false;
+    if (header.rows < 0 || header.columns < 0 || header.trainCapacity < 0) return false;
+    if (header.numSwitches < 0 || header.numSwitches > maximum_switches) return false;
+    if (header.numSpawns < 0 || header.numSpawns > header.trainCapacity) return false;
+    if (header.numDestinations < 0 || header.numDestinations > header.trainCapacity) return false;
+    uint64_t states = (uint64_t)header.rows * (uint64_t)header.columns * 4;
+    if (header.routeStates != 0 && header.routeStates != states) return false;
+
+    //Offsets must be exactly the ones this version lays out
+    CompiledHeader expected = header;
+    layoutSections(expected);
+    return memcmp(&expected, &header, sizeof(header)) == 0 && header.fileBytes == fileBytes;
+}
+
+// ----------------------------------------------------------------------------
+// Load a compiled level from memory.
+// ----------------------------------------------------------------------------
+bool loadCompiledImage(SimulationContext &ctx, const char *image, size_t bytes,
+                       unsigned long long sourceHash) {
+    if (bytes < sizeof(CompiledHeader)) return false;
+    CompiledHeader header;
+    memcpy(&header, image, sizeof(header));
+    if (!validateCompiled(header, bytes, sourceHash) ||
+        !allocateWorld(ctx, header.rows, header.columns, header.trainCapacity)) {
+        return false;
+    }
+
+    ctx.levelHash    = header.sourceHash;
+    ctx.levelSeed    = header.levelSeed;
+    ctx.weather_type = header.weather;
+
+    size_t cells = (size_t)header.rows * header.columns;
+    for (int r = 0; r < header.rows; r++) {
+        const char *row = image + header.gridOffset + (size_t)r * header.columns;
+        memcpy(ctx.grid[r], row, header.columns);
+        memcpy(ctx.originalGrid[r], row, header.columns);
+    }
+    memcpy(ctx.tileInfo, image + header.tileOffset, cells * sizeof(TileInfo));
+
+    const CompiledSwitch *switches = (const CompiledSwitch*)(image + header.switchOffset);
+    ctx.numSwitches = header.numSwitches;
+    for (int i = 0; i < header.numSwitches; i++) {
+        ctx.switchLetter[i]  = switches[i].letter;
+        ctx.switchMode[i]    = switches[i].mode;
+        ctx.switchState[i]   = switches[i].state;
+        ctx.switchFlipped[i] = 0;
+        for (int k = 0; k < 4; k++) {
+            ctx.switchK[i][k] = switches[i].k[k];
+            ctx.switchCounter[i][k] = 0;
+        }
+    }
+    const CompiledSpawn *spawns = (const CompiledSpawn*)(image + header.spawnOffset);
+    ctx.num_spawn = header.numSpawns;
+    for (int i = 0; i < header.numSpawns; i++) {
+        ctx.spawnTick[i]      = spawns[i].tick;
+        ctx.spawnn_Row[i]     = spawns[i].row;
+        ctx.spawnn_Column[i]  = spawns[i].column;
+        ctx.spawnDirection[i] = spawns[i].direction;
+        ctx.spawnColor[i]     = spawns[i].color;
+        ctx.spawnTrainID[i]   = -1;
+    }
+    const CompiledDestination *destinations =
+        (const CompiledDestination*)(image + header.destinationOffset);
+    ctx.numDest = header.numDestinations;
+    for (int d = 0; d < header.numDestinations; d++) {
+        ctx.destinationRow[d]     = destinations[d].row;
+        ctx.destinationColumn[d]  = destinations[d].column;
+        ctx.destinationTrainID[d] = destinations[d].trainID;
+    }
+    memcpy(ctx.trainDestination, image + header.trainDestinationOffset,
+           (size_t)header.trainCapacity * sizeof(int32_t));
+
+    bool routed = true;
+    if (header.routeStates > 0) {
+        ctx.routeField = (unsigned short*)malloc(header.routeStates * sizeof(uint16_t));
+        if (ctx.routeField) {
+            memcpy(ctx.routeField, image + header.routeOffset, header.routeStates * sizeof(uint16_t));
+        }
+        routed = ctx.routeField != 0;
+    } else {
+        //Not stored (planner-sized map or no destinations): build as usual
+        buildRouteField(ctx);
+    }
+    buildTrackGraph(ctx);                        // Cheap; not stored
+    if (ctx.levelSeed != 0) seedRandom(ctx, ctx.levelSeed);
+    return routed;
+}
+
+// ----------------------------------------------------------------------------
+// Load a compiled level.
+// ----------------------------------------------------------------------------
+bool loadCompiledLevel(SimulationContext &ctx, const string &path,
+                       unsigned long long sourceHash) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat status;
+    if (fstat(fd, &status) != 0 || (size_t)status.st_size < sizeof(CompiledHeader)) {
+        close(fd);
+        return false;
+    }
+    size_t fileBytes = (size_t)status.st_size;
+    void *mapped = mmap(0, fileBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) return false;
+
+    bool loaded = loadCompiledImage(ctx, (const char*)mapped, fileBytes, sourceHash);
+    munmap(mapped, fileBytes);
+    return loaded;
+}
+
+// ----------------------------------------------------------------------------
+// Load a .lvl through the cache.
+// ----------------------------------------------------------------------------
+bool loadLevelCached(SimulationContext &ctx, const string &filename, const string &cacheDir) {
+    unsigned long long hash = hashLevelFile(filename);
+    if (hash == 0) return loadLevelFile(ctx, filename);   // Unreadable: report as usual
+
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.lvlc", hash);
+    string path = cacheDir + "/" + name;
+    if (loadCompiledLevel(ctx, path, hash)) {
+        cout << "Level loaded: " << filename << endl;
+        return true;
+    }
+
+    if (!loadLevelFile(ctx, filename)) return false;
+    mkdir(cacheDir.c_str(), 0777);               // Fine if it already exists
+    if (!writeCompiledLevel(ctx, path)) {
+        cout << "Warning: Could not write level cache " << path << endl;
+    }
+    return true;
+}
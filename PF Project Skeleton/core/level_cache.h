@@ -0,0 +1,43 @@
+#ifndef LEVEL_CACHE_H
+#define LEVEL_CACHE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// ============================================================================
+// LEVEL_CACHE.H - Compiled levels
+// ============================================================================
+// A compiled level is the state loadLevelFile leaves behind (grid, tile
+// records, switch/spawn/destination tables and the distance field) written
+// as flat sections behind a header carrying the source file's hash. Loading
+// one maps the file and copies the sections into the context, skipping the
+// text parse, the spawn fix-ups and the routing search.
+// ============================================================================
+
+struct SimulationContext;
+
+// Compile the loaded level in ctx into `image` (the file layout, in memory).
+bool compileLevel(const SimulationContext &ctx, std::vector<char> &image);
+
+// Load a compiled image held in memory (see loadCompiledLevel). The image is
+// only read, so one image can be loaded by many threads at once.
+bool loadCompiledImage(SimulationContext &ctx, const char *image, size_t bytes,
+                       unsigned long long sourceHash);
+
+// Write the loaded level in ctx to `path`. Returns false on I/O errors.
+bool writeCompiledLevel(const SimulationContext &ctx, const std::string &path);
+
+// Load a compiled level. Fails (leaving ctx to be reloaded) if the file is
+// missing, damaged, from another format version, or was compiled from a
+// source whose hash is not `sourceHash` (pass 0 to accept any source).
+bool loadCompiledLevel(SimulationContext &ctx, const std::string &path,
+                       unsigned long long sourceHash);
+
+// Load a .lvl through the cache directory `cacheDir`: the compiled copy
+// <cacheDir>/<source hash>.lvlc is used when present, otherwise the level is
+// parsed and the compiled copy written for next time.
+bool loadLevelCached(SimulationContext &ctx, const std::string &filename,
+                     const std::string &cacheDir);
+
+#endif
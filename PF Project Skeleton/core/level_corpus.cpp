@@ -0,0 +1,86 @@
+#include "level_corpus.h"
+#include "simulation.h"
+#include <algorithm>
+#include <atomic>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <thread>
+
+using namespace std;
+
+// ============================================================================
+// LEVEL_CORPUS.CPP - Bulk level loading
+// ============================================================================
+// Every level gets its own context, so workers share nothing but the index
+// of the next file to load. Handing out one file at a time keeps the
+// threads busy when level sizes differ a lot.
+// ============================================================================
+
+static bool hasLevelExtension(const string &name) {
+    return name.size() > 4 && name.compare(name.size() - 4, 4, ".lvl") == 0;
+}
+
+bool listLevelFiles(const string &directory, vector<string> &files) {
+    DIR *dir = opendir(directory.c_str());
+    if (!dir) return false;
+
+    vector<string> found;
+    while (dirent *entry = readdir(dir)) {
+        string name = entry->d_name;
+        if (!hasLevelExtension(name)) continue;
+        string path = directory + "/" + name;
+        struct stat status;
+        if (stat(path.c_str(), &status) == 0 && S_ISREG(status.st_mode)) found.push_back(path);
+    }
+    closedir(dir);
+
+    sort(found.begin(), found.end());
+    files.insert(files.end(), found.begin(), found.end());
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Load one file into its slot.
+// ----------------------------------------------------------------------------
+static void loadOne(const string &filename, LoadedLevel &level) {
+    level.filename = filename;
+    struct stat status;
+    level.bytes = stat(filename.c_str(), &status) == 0 ? (size_t)status.st_size : 0;
+
+    level.ctx.reset(new SimulationContext());
+    initializeSimulation(*level.ctx);
+    level.loaded = loadLevelFile(*level.ctx, filename, &level.error);
+    if (!level.loaded) level.ctx.reset();
+}
+
+static void loadWorker(const vector<string> &files, vector<LoadedLevel> &levels,
+                       atomic<size_t> &next) {
+    for (;;) {
+        size_t i = next.fetch_add(1);
+        if (i >= files.size()) return;
+        loadOne(files[i], levels[i]);
+    }
+}
+
+size_t loadLevelCorpus(const vector<string> &files, int threads, vector<LoadedLevel> &levels) {
+    levels.clear();
+    levels.resize(files.size());
+
+    if (threads <= 0) threads = (int)thread::hardware_concurrency();
+    if (threads <= 0) threads = 1;
+    if ((size_t)threads > files.size()) threads = (int)files.size();
+
+    atomic<size_t> next(0);
+    vector<thread> workers;
+    for (int t = 1; t < threads; t++) {
+        workers.push_back(thread(loadWorker, cref(files), ref(levels), ref(next)));
+    }
+    loadWorker(files, levels, next);            // The caller works too
+    for (size_t t = 0; t < workers.size(); t++) workers[t].join();
+
+    size_t loaded = 0;
+    for (size_t i = 0; i < levels.size(); i++) {
+        if (levels[i].loaded) loaded++;
+    }
+    return loaded;
+}
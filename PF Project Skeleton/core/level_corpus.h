@@ -0,0 +1,38 @@
+#ifndef LEVEL_CORPUS_H
+#define LEVEL_CORPUS_H
+
+#include "io.h"
+#include "simulation_state.h"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+// ============================================================================
+// LEVEL_CORPUS.H - Bulk level loading
+// ============================================================================
+// Loads many .lvl files at once, each into its own SimulationContext, on a
+// pool of worker threads. Failures are kept per file (with the line number
+// when the problem is inside the file) instead of being printed.
+// ============================================================================
+
+struct LoadedLevel {
+    std::string filename;
+    size_t bytes;                               // Size of the .lvl file
+    bool loaded;
+    LevelLoadError error;                       // Set when !loaded
+    std::unique_ptr<SimulationContext> ctx;     // Ready to run; null when !loaded
+
+    LoadedLevel() : bytes(0), loaded(false) {}
+};
+
+// Append the .lvl files directly inside `directory` to `files`, sorted by
+// name. Returns false if the directory cannot be read.
+bool listLevelFiles(const std::string &directory, std::vector<std::string> &files);
+
+// Load every file in `files` into `levels` (same order) using `threads`
+// worker threads (0 = one per hardware thread). Returns the number loaded.
+size_t loadLevelCorpus(const std::vector<std::string> &files, int threads,
+                       std::vector<LoadedLevel> &levels);
+
+#endif
@@ -0,0 +1,237 @@
+#include "optimizer.h"
+#include "simulation_state.h"
+#include "simulation.h"
+#include "level_cache.h"
+#include "work_stealing.h"
+#include <fstream>
+#include <memory>
+#include <random>
+#include <sstream>
+
+using namespace std;
+
+// ============================================================================
+// OPTIMIZER.CPP - Search over switch K values and spawn ticks
+// ============================================================================
+
+OptimizerOptions::OptimizerOptions()
+    : generations(40), candidates(32), maxK(switch_max_K), maxSpawnShift(8),
+      seed(1), threads(0) {}
+
+bool betterTuningScore(const TuningScore &a, const TuningScore &b) {
+    if (a.delivered != b.delivered) return a.delivered > b.delivered;
+    return a.waitTicks < b.waitTicks;
+}
+
+// ----------------------------------------------------------------------------
+// Tuning <-> context.
+// ----------------------------------------------------------------------------
+static LevelTuning captureTuning(const SimulationContext &ctx) {
+    LevelTuning tuning;
+    for (int i = 0; i < ctx.numSwitches; i++) {
+        for (int k = 0; k < 4; k++) tuning.switchK.push_back(ctx.switchK[i][k]);
+    }
+    for (int i = 0; i < ctx.num_spawn; i++) tuning.spawnTick.push_back(ctx.spawnTick[i]);
+    return tuning;
+}
+
+static void applyTuning(SimulationContext &ctx, const LevelTuning &tuning) {
+    for (int i = 0; i < ctx.numSwitches; i++) {
+        for (int k = 0; k < 4; k++) ctx.switchK[i][k] = tuning.switchK[i * 4 + k];
+    }
+    for (int i = 0; i < ctx.num_spawn; i++) ctx.spawnTick[i] = tuning.spawnTick[i];
+}
+
+// ----------------------------------------------------------------------------
+// Early stop.
+// ----------------------------------------------------------------------------
+// Waiting time only grows, and a train can only still be delivered if it has
+// not crashed and its spawn has not been missed (a spawn onto an occupied
+// tile is not retried). A run that cannot deliver more than the incumbent,
+// or deliver as many while waiting less, cannot win.
+// ----------------------------------------------------------------------------
+static bool canStillWin(const SimulationContext &ctx, const TuningScore &incumbent) {
+    int deliverable = ctx.num_spawn - ctx.crashed_trains;
+    for (int i = 0; i < ctx.num_spawn; i++) {
+        if (ctx.spawnTrainID[i] == -1 && ctx.spawnTick[i] < ctx.currentTick) deliverable--;
+    }
+    if (deliverable != incumbent.delivered) return deliverable > incumbent.delivered;
+    return ctx.totalWaitTicks < incumbent.waitTicks;
+}
+
+// ----------------------------------------------------------------------------
+// Simulate one tuning from the shared image (incumbent 0: run to the end).
+// ----------------------------------------------------------------------------
+static TuningScore evaluateTuning(SimulationContext &ctx, const vector<char> &image,
+                                  const LevelTuning &tuning, const TuningScore *incumbent) {
+    initializeSimulation(ctx);
+    loadCompiledImage(ctx, &image[0], image.size(), 0);
+    applyTuning(ctx, tuning);
+
+    TuningScore score;
+    score.finished = true;
+    while (true) {
+        advanceUntilNextEvent(ctx);
+        if (isSimulationComplete(ctx)) break;
+        if (incumbent && !canStillWin(ctx, *incumbent)) {
+            score.finished = false;
+            break;
+        }
+    }
+    score.delivered      = ctx.trainsReached;
+    score.crashed        = ctx.crashed_trains;
+    score.waitTicks      = ctx.totalWaitTicks;
+    score.completionTick = ctx.currentTick;
+    return score;
+}
+
+// ----------------------------------------------------------------------------
+// Candidates.
+// ----------------------------------------------------------------------------
+// Raw mt19937 output only, so a seed gives the same search on every compiler.
+static int indexRandom(mt19937 &rng, int n) {
+    return (int)(rng() % (unsigned int)n);
+}
+
+// Change one to three values of `from`: a K value to any of 1..maxK, or a
+// spawn tick to any tick within maxSpawnShift of the level's own
+static LevelTuning mutateTuning(const LevelTuning &from, const LevelTuning &original,
+                                const OptimizerOptions &options, mt19937 &rng) {
+    LevelTuning tuning = from;
+    int kGenes = options.maxK > 0 ? (int)tuning.switchK.size() : 0;
+    int tickGenes = options.maxSpawnShift > 0 ? (int)tuning.spawnTick.size() : 0;
+    if (kGenes + tickGenes == 0) return tuning;
+
+    int changes = 1 + indexRandom(rng, 3);
+    for (int c = 0; c < changes; c++) {
+        int gene = indexRandom(rng, kGenes + tickGenes);
+        if (gene < kGenes) {
+            tuning.switchK[gene] = 1 + indexRandom(rng, options.maxK);
+        } else {
+            int s = gene - kGenes;
+            int low = original.spawnTick[s] - options.maxSpawnShift;
+            if (low < 0) low = 0;
+            int high = original.spawnTick[s] + options.maxSpawnShift;
+            tuning.spawnTick[s] = low + indexRandom(rng, high - low + 1);
+        }
+    }
+    return tuning;
+}
+
+// ----------------------------------------------------------------------------
+// Search.
+// ----------------------------------------------------------------------------
+bool optimizeLevel(const string &level, const OptimizerOptions &options,
+                   OptimizerResult &result, LevelLoadError *error) {
+    result = OptimizerResult();
+
+    // Parse once; every evaluation copies the compiled image instead
+    vector<char> image;
+    {
+        SimulationContext ctx;
+        initializeSimulation(ctx);
+        LevelLoadError loadError;
+        if (!loadLevelFile(ctx, level, &loadError)) {
+            if (error) *error = loadError;
+            return false;
+        }
+        if (!compileLevel(ctx, image)) {
+            if (error) {
+                error->file = level;
+                error->line = 0;
+                error->message = "Could not compile level";
+            }
+            return false;
+        }
+        result.original = captureTuning(ctx);
+    }
+
+    int candidates = options.candidates > 0 ? options.candidates : 1;
+    int threads = workStealingThreads(candidates, options.threads);
+    vector<unique_ptr<SimulationContext> > contexts(threads);
+    for (int t = 0; t < threads; t++) contexts[t].reset(new SimulationContext());
+
+    result.best = result.original;
+    result.originalScore = evaluateTuning(*contexts[0], image, result.original, 0);
+    result.bestScore = result.originalScore;
+    result.evaluated = 1;
+    result.stoppedEarly = 0;
+
+    mt19937 rng(options.seed);
+    vector<LevelTuning> round(candidates);
+    vector<TuningScore> scores(candidates);
+    for (int g = 0; g < options.generations; g++) {
+        for (int c = 0; c < candidates; c++) {
+            round[c] = mutateTuning(result.best, result.original, options, rng);
+        }
+
+        // Every candidate races the round's incumbent, so the outcome does
+        // not depend on which thread finishes first
+        const TuningScore incumbent = result.bestScore;
+        runWorkStealing(candidates, threads, [&](size_t index, int worker) {
+            scores[index] = evaluateTuning(*contexts[worker], image, round[index], &incumbent);
+        });
+
+        int winner = -1;
+        for (int c = 0; c < candidates; c++) {
+            result.evaluated++;
+            if (!scores[c].finished) {
+                result.stoppedEarly++;
+                continue;
+            }
+            if (!betterTuningScore(scores[c], incumbent)) continue;
+            if (winner == -1 || betterTuningScore(scores[c], scores[winner])) winner = c;
+        }
+        if (winner != -1) {
+            result.best = round[winner];
+            result.bestScore = scores[winner];
+            result.improvedAt.push_back(g);
+            result.improvements.push_back(scores[winner]);
+        }
+    }
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Write the tuned level.
+// ----------------------------------------------------------------------------
+// Entries are rewritten one line at a time, so each switch and train entry
+// has to sit on its own line (as in every shipped and generated level).
+// ----------------------------------------------------------------------------
+bool writeTunedLevel(const string &source, const string &destination,
+                     const LevelTuning &tuning) {
+    ifstream in(source.c_str());
+    if (!in.is_open()) return false;
+
+    size_t switches = tuning.switchK.size() / 4;
+    size_t switchAt = 0, spawnAt = 0;
+    string section;
+    ostringstream out;
+    string line;
+    while (getline(in, line)) {
+        istringstream words(line);
+        vector<string> tokens;
+        string word;
+        while (words >> word) tokens.push_back(word);
+
+        if (tokens.size() == 1 && tokens[0][tokens[0].size() - 1] == ':') {
+            section = tokens[0];
+        } else if (section == "SWITCHES:" && tokens.size() >= 7 && switchAt < switches) {
+            for (int k = 0; k < 4; k++) tokens[3 + k] = to_string((long long)tuning.switchK[switchAt * 4 + k]);
+            switchAt++;
+            line = tokens[0];
+            for (size_t t = 1; t < tokens.size(); t++) line += " " + tokens[t];
+        } else if (section == "TRAINS:" && tokens.size() >= 5 && spawnAt < tuning.spawnTick.size()) {
+            tokens[0] = to_string((long long)tuning.spawnTick[spawnAt++]);
+            line = tokens[0];
+            for (size_t t = 1; t < tokens.size(); t++) line += " " + tokens[t];
+        }
+        out << line << "\n";
+    }
+    if (switchAt != switches || spawnAt != tuning.spawnTick.size()) return false;
+
+    ofstream file(destination.c_str());
+    if (!file.is_open()) return false;
+    file << out.str();
+    return file.good();
+}
@@ -0,0 +1,73 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "io.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// ============================================================================
+// OPTIMIZER.H - Search over switch K values and spawn ticks
+// ============================================================================
+// Tunes a level's switch flip thresholds (the four K values per switch) and
+// train spawn ticks to deliver the most trains, then to wait the fewest
+// ticks. The level is parsed once into a compiled image that every worker
+// loads candidates from; candidates are simulated in parallel and dropped as
+// soon as they can no longer beat the best tuning found so far.
+// ============================================================================
+
+// The tunable values of a level.
+struct LevelTuning {
+    std::vector<int> switchK;       // Four K values per switch, in SWITCHES order
+    std::vector<int> spawnTick;     // One tick per TRAINS entry
+};
+
+// Outcome of one simulated tuning.
+struct TuningScore {
+    bool finished;                  // False: stopped early, could not win
+    int delivered;
+    int crashed;
+    int waitTicks;
+    int completionTick;
+
+    TuningScore() : finished(false), delivered(0), crashed(0), waitTicks(0), completionTick(0) {}
+};
+
+struct OptimizerOptions {
+    int generations;                // Rounds of candidates
+    int candidates;                 // Candidates per round
+    int maxK;                       // K values are tried from 1 to maxK
+    int maxSpawnShift;              // Spawn ticks stay this close to the level's
+    unsigned int seed;              // Search seed (same seed, same result)
+    int threads;                    // 0 = one per hardware thread
+
+    OptimizerOptions();
+};
+
+struct OptimizerResult {
+    LevelTuning original;
+    LevelTuning best;
+    TuningScore originalScore;
+    TuningScore bestScore;
+    std::vector<int> improvedAt;            // Rounds that found a better tuning
+    std::vector<TuningScore> improvements;  // ...and the score it had
+    size_t evaluated;                       // Candidates simulated
+    size_t stoppedEarly;                    // ...of which were dropped early
+};
+
+// True if `a` delivers more trains than `b`, or as many with less waiting.
+bool betterTuningScore(const TuningScore &a, const TuningScore &b);
+
+// Search tunings for `level`: a (1+lambda) evolution strategy where every
+// round mutates the best tuning so far into `candidates` new ones. Returns
+// false (with `error` set) if the level cannot be loaded.
+bool optimizeLevel(const std::string &level, const OptimizerOptions &options,
+                   OptimizerResult &result, LevelLoadError *error);
+
+// Copy the .lvl `source` to `destination` with its SWITCHES K values and
+// TRAINS spawn ticks replaced by `tuning`; every other line is kept as is.
+// Returns false on I/O errors or if the entries do not match the tuning.
+bool writeTunedLevel(const std::string &source, const std::string &destination,
+                     const LevelTuning &tuning);
+
+#endif
@@ -0,0 +1,475 @@
+#include "routing.h"
+#include "simulation_state.h"
+#include "grid.h"
+#include <cstdlib>
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// ============================================================================
+// ROUTING.CPP - Track distance field and hierarchical planner
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// Can a train on tile `info` that arrived heading `heading` leave by `exit`?
+// ----------------------------------------------------------------------------
+// Mirrors getNextDirection: plain track follows the turn table, crossings may
+// leave by any track neighbour, and switches go straight when they can, else
+// left/right (the switch state decides which), else back.
+// ----------------------------------------------------------------------------
+static bool canExit(const TileInfo &info, int heading, int exit) {
+    if (!((info.trackMask >> exit) & 1)) return false;
+    if (info.tileClass == tile_empty || info.tileClass == tile_other) return false;
+
+    int turn = turnTable[info.routeClass][heading];
+    if (turn != route_dynamic) return turn == exit;
+    if (info.routeClass == tile_crossing) return true;
+
+    int straight = heading;
+    int back     = (heading + 2) % 4;
+    if ((info.trackMask >> straight) & 1) return exit == straight;
+    bool sideOpen = (info.trackMask & ~((1 << straight) | (1 << back))) != 0;
+    if (sideOpen) return exit != back;
+    return exit == back;
+}
+
+// ----------------------------------------------------------------------------
+// Ticks spent moving onto a tile: one move, plus the wait on a safety tile.
+// ----------------------------------------------------------------------------
+static int entryCost(const TileInfo &info) {
+    return info.tileClass == tile_safety ? 2 : 1;
+}
+
+// ----------------------------------------------------------------------------
+// Build the flat delivery distance field.
+// ----------------------------------------------------------------------------
+// Searches backwards from every destination tile at once. Move costs are 1 or
+// 2 ticks, so states are kept in three rotating buckets (Dial's algorithm).
+// ----------------------------------------------------------------------------
+static bool buildFlatField(SimulationContext &ctx) {
+    size_t states = (size_t)ctx.number_rows * ctx.number_column * 4;
+    ctx.routeField = (unsigned short*)malloc(states * sizeof(unsigned short));
+    if (!ctx.routeField) return false;
+
+    unsigned short *field = ctx.routeField;
+    for (size_t s = 0; s < states; s++) field[s] = route_unreachable;
+
+    vector<int> bucket[3];
+    for (int d = 0; d < ctx.numDest; d++) {
+        if (!isInBounds(ctx, ctx.destinationRow[d], ctx.destinationColumn[d])) continue;
+        int cell = ctx.destinationRow[d] * ctx.number_column + ctx.destinationColumn[d];
+        for (int h = 0; h < 4; h++) {
+            if (field[cell * 4 + h] == 0) continue;
+            field[cell * 4 + h] = 0;
+            bucket[0].push_back(cell * 4 + h);
+        }
+    }
+
+    size_t pending = bucket[0].size();
+    for (int ticks = 0; pending > 0 && ticks + 2 < route_unreachable; ticks++) {
+        vector<int> &current = bucket[ticks % 3];
+        for (size_t k = 0; k < current.size(); k++) {
+            int state = current[k];
+            if (field[state] != ticks) continue;   // improved after it was queued
+
+            int cell = state / 4;
+            int exit = state % 4;              // heading the train arrived with
+            int cost = entryCost(ctx.tileInfo[cell]);
+
+            // The train came from the neighbour behind it
+            int row = cell / ctx.number_column - row_change[exit];
+            int col = cell % ctx.number_column - column_change[exit];
+            if (!isInBounds(ctx, row, col)) continue;
+
+            int from = row * ctx.number_column + col;
+            const TileInfo &info = ctx.tileInfo[from];
+            for (int h = 0; h < 4; h++) {
+                if (field[from * 4 + h] <= ticks + cost) continue;
+                if (!canExit(info, h, exit)) continue;
+                field[from * 4 + h] = (unsigned short)(ticks + cost);
+                bucket[(ticks + cost) % 3].push_back(from * 4 + h);
+                pending++;
+            }
+        }
+        pending -= current.size();
+        current.clear();
+    }
+    return true;
+}
+
+// ============================================================================
+// HIERARCHICAL PLANNER
+// ============================================================================
+// Used when the flat field would not fit route_field_budget. The map is cut
+// into route_cluster_size squares. Entry states (a train arriving on a tile
+// from another cluster) form an abstract graph whose edges are shortest paths
+// inside one cluster, so their ticks to delivery are exact. A query refines
+// its cluster once into a local field kept in a fixed-size clock cache.
+// ============================================================================
+static const unsigned int planner_unreachable = 0xFFFFFFFFu;
+
+typedef pair<unsigned int, int> QueueEntry;               // (ticks, state)
+typedef priority_queue<QueueEntry, vector<QueueEntry>, greater<QueueEntry> > TickQueue;
+
+struct RoutePlanner {
+    int clusterColumns;
+    vector<int> nodeState;              // Entry states (cell*4+heading), ascending
+    vector<unsigned int> nodeTicks;     // Ticks to delivery per entry state
+    vector<int> clusterSlot;            // Cache slot holding each cluster, or -1
+    vector<int> slotCluster;            // Cluster held by each slot, or -1
+    vector<unsigned char> slotUsed;     // Clock reference bits
+    vector<unsigned int> slotTicks;     // Local fields, one block per slot
+    vector<int> seedFirst;              // First refinement seed per cluster
+    vector<unsigned int> seedTicks;     // Seed ticks, ascending per cluster
+    vector<int> seedState;              // Seed local states
+    vector<int> bucket[3];              // Refinement buckets, reused
+    int clockHand;
+};
+
+static const int cluster_states = route_cluster_size * route_cluster_size * 4;
+
+static int clusterOf(const SimulationContext &ctx, int cell) {
+    int row = cell / ctx.number_column;
+    int col = cell % ctx.number_column;
+    int clusterColumns = (ctx.number_column + route_cluster_size - 1) / route_cluster_size;
+    return (row / route_cluster_size) * clusterColumns + col / route_cluster_size;
+}
+
+// State index inside its cluster's local field
+static int localState(const SimulationContext &ctx, int state) {
+    int cell = state / 4;
+    int row  = (cell / ctx.number_column) % route_cluster_size;
+    int col  = (cell % ctx.number_column) % route_cluster_size;
+    return (row * route_cluster_size + col) * 4 + state % 4;
+}
+
+static bool isDestinationCell(const SimulationContext &ctx, int cell) {
+    return (ctx.tileInfo[cell].pointMask & point_destination) != 0;
+}
+
+// Next cell when leaving `cell` by `exit` (caller checked canExit)
+static int stepCell(const SimulationContext &ctx, int cell, int exit) {
+    return cell + row_change[exit] * ctx.number_column + column_change[exit];
+}
+
+static int findNode(const RoutePlanner &planner, int state) {
+    vector<int>::const_iterator it =
+        lower_bound(planner.nodeState.begin(), planner.nodeState.end(), state);
+    if (it == planner.nodeState.end() || *it != state) return -1;
+    return (int)(it - planner.nodeState.begin());
+}
+
+// ----------------------------------------------------------------------------
+// Build the abstract graph and its distances to delivery.
+// ----------------------------------------------------------------------------
+static void buildPlannerGraph(SimulationContext &ctx, RoutePlanner &planner) {
+    int cells = ctx.number_rows * ctx.number_column;
+
+    // Entry states: arrivals on a border tile from a neighbouring cluster
+    for (int cell = 0; cell < cells; cell++) {
+        int row = cell / ctx.number_column;
+        int col = cell % ctx.number_column;
+        for (int e = 0; e < 4; e++) {
+            int fromRow = row - row_change[e];
+            int fromCol = col - column_change[e];
+            if (!isInBounds(ctx, fromRow, fromCol)) continue;
+            int from = fromRow * ctx.number_column + fromCol;
+            if (clusterOf(ctx, from) == clusterOf(ctx, cell)) continue;
+            for (int h = 0; h < 4; h++) {
+                if (canExit(ctx.tileInfo[from], h, e)) {
+                    planner.nodeState.push_back(cell * 4 + e);
+                    break;
+                }
+            }
+        }
+    }
+
+    // Shortest paths from each entry state while staying in its cluster
+    int nodes = (int)planner.nodeState.size();
+    vector<unsigned int> sinkTicks(nodes, planner_unreachable);
+    vector<int> edgeFrom, edgeTo;
+    vector<unsigned int> edgeTicks;
+    vector<unsigned int> local(cluster_states, planner_unreachable);
+    vector<int> touched;
+    for (int n = 0; n < nodes; n++) {
+        int cluster = clusterOf(ctx, planner.nodeState[n] / 4);
+        TickQueue queue;
+        queue.push(QueueEntry(0, planner.nodeState[n]));
+        local[localState(ctx, planner.nodeState[n])] = 0;
+        touched.push_back(localState(ctx, planner.nodeState[n]));
+
+        while (!queue.empty()) {
+            unsigned int ticks = queue.top().first;
+            int state = queue.top().second;
+            queue.pop();
+            if (ticks > local[localState(ctx, state)]) continue;
+
+            int cell = state / 4;
+            if (isDestinationCell(ctx, cell)) {
+                // Delivered here
+                if (ticks < sinkTicks[n]) sinkTicks[n] = ticks;
+                continue;
+            }
+            for (int x = 0; x < 4; x++) {
+                if (!canExit(ctx.tileInfo[cell], state % 4, x)) continue;
+                int next = stepCell(ctx, cell, x);
+                unsigned int nextTicks = ticks + entryCost(ctx.tileInfo[next]);
+                if (clusterOf(ctx, next) != cluster) {
+                    edgeFrom.push_back(n);
+                    edgeTo.push_back(findNode(planner, next * 4 + x));
+                    edgeTicks.push_back(nextTicks);
+                    continue;
+                }
+                int slot = localState(ctx, next * 4 + x);
+                if (nextTicks < local[slot]) {
+                    if (local[slot] == planner_unreachable) touched.push_back(slot);
+                    local[slot] = nextTicks;
+                    queue.push(QueueEntry(nextTicks, next * 4 + x));
+                }
+            }
+        }
+        for (size_t t = 0; t < touched.size(); t++) local[touched[t]] = planner_unreachable;
+        touched.clear();
+    }
+
+    // Reverse adjacency: edges grouped by the node they lead to
+    vector<int> firstEdge(nodes + 1, 0);
+    for (size_t e = 0; e < edgeTo.size(); e++) firstEdge[edgeTo[e] + 1]++;
+    for (int n = 0; n < nodes; n++) firstEdge[n + 1] += firstEdge[n];
+    vector<int> fill(firstEdge.begin(), firstEdge.end() - 1);
+    vector<int> reverseFrom(edgeTo.size());
+    vector<unsigned int> reverseTicks(edgeTo.size());
+    for (size_t e = 0; e < edgeTo.size(); e++) {
+        int at = fill[edgeTo[e]]++;
+        reverseFrom[at]  = edgeFrom[e];
+        reverseTicks[at] = edgeTicks[e];
+    }
+
+    // Dijkstra backwards from the entry states that reach a destination
+    planner.nodeTicks = sinkTicks;
+    TickQueue queue;
+    for (int n = 0; n < nodes; n++) {
+        if (sinkTicks[n] != planner_unreachable) queue.push(QueueEntry(sinkTicks[n], n));
+    }
+    while (!queue.empty()) {
+        unsigned int ticks = queue.top().first;
+        int n = queue.top().second;
+        queue.pop();
+        if (ticks > planner.nodeTicks[n]) continue;
+        for (int e = firstEdge[n]; e < firstEdge[n + 1]; e++) {
+            int from = reverseFrom[e];
+            if (ticks + reverseTicks[e] < planner.nodeTicks[from]) {
+                planner.nodeTicks[from] = ticks + reverseTicks[e];
+                queue.push(QueueEntry(planner.nodeTicks[from], from));
+            }
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Seed states for refining each cluster.
+// ----------------------------------------------------------------------------
+// Destination tiles seed 0; a state that can leave the cluster seeds the
+// cheapest exit into an entry state. Kept per cluster in ascending ticks.
+// ----------------------------------------------------------------------------
+static void buildClusterSeeds(SimulationContext &ctx, RoutePlanner &planner, int clusters) {
+    vector<pair<int, QueueEntry> > seeds;           // (cluster, (ticks, local state))
+    int cells = ctx.number_rows * ctx.number_column;
+    for (int cell = 0; cell < cells; cell++) {
+        int cluster = clusterOf(ctx, cell);
+        for (int h = 0; h < 4; h++) {
+            unsigned int best = planner_unreachable;
+            if (isDestinationCell(ctx, cell)) {
+                best = 0;
+            } else {
+                for (int x = 0; x < 4; x++) {
+                    if (!canExit(ctx.tileInfo[cell], h, x)) continue;
+                    int next = stepCell(ctx, cell, x);
+                    if (clusterOf(ctx, next) == cluster) continue;
+                    unsigned int beyond = planner.nodeTicks[findNode(planner, next * 4 + x)];
+                    if (beyond == planner_unreachable) continue;
+                    unsigned int ticks = beyond + entryCost(ctx.tileInfo[next]);
+                    if (ticks < best) best = ticks;
+                }
+            }
+            if (best == planner_unreachable) continue;
+            seeds.push_back(make_pair(cluster, QueueEntry(best, localState(ctx, cell * 4 + h))));
+        }
+    }
+    sort(seeds.begin(), seeds.end());
+
+    planner.seedFirst.assign(clusters + 1, 0);
+    planner.seedTicks.resize(seeds.size());
+    planner.seedState.resize(seeds.size());
+    for (size_t k = 0; k < seeds.size(); k++) {
+        planner.seedFirst[seeds[k].first + 1]++;
+        planner.seedTicks[k] = seeds[k].second.first;
+        planner.seedState[k] = seeds[k].second.second;
+    }
+    for (int c = 0; c < clusters; c++) planner.seedFirst[c + 1] += planner.seedFirst[c];
+}
+
+// ----------------------------------------------------------------------------
+// Refine one cluster into a cache slot (evicting with the clock hand).
+// ----------------------------------------------------------------------------
+// Same backwards search as the flat field, in cluster-local coordinates; seeds
+// join the buckets when the search reaches their tick count.
+// ----------------------------------------------------------------------------
+static int refineCluster(const SimulationContext &ctx, RoutePlanner &planner, int cluster) {
+    int slots = (int)planner.slotCluster.size();
+    while (planner.slotUsed[planner.clockHand]) {
+        planner.slotUsed[planner.clockHand] = 0;
+        planner.clockHand = (planner.clockHand + 1) % slots;
+    }
+    int slot = planner.clockHand;
+    planner.clockHand = (planner.clockHand + 1) % slots;
+    if (planner.slotCluster[slot] != -1) planner.clusterSlot[planner.slotCluster[slot]] = -1;
+    planner.slotCluster[slot] = cluster;
+    planner.clusterSlot[cluster] = slot;
+
+    unsigned int *field = &planner.slotTicks[(size_t)slot * cluster_states];
+    for (int s = 0; s < cluster_states; s++) field[s] = planner_unreachable;
+
+    int firstRow = (cluster / planner.clusterColumns) * route_cluster_size;
+    int firstCol = (cluster % planner.clusterColumns) * route_cluster_size;
+    int next = planner.seedFirst[cluster];
+    int last = planner.seedFirst[cluster + 1];
+    if (next == last) return slot;
+
+    vector<int> *bucket = planner.bucket;
+    size_t pending = 0;
+    unsigned int ticks = planner.seedTicks[next];
+    while (pending > 0 || next < last) {
+        if (pending == 0 && planner.seedTicks[next] > ticks) ticks = planner.seedTicks[next];
+        for (; next < last && planner.seedTicks[next] == ticks; next++) {
+            int state = planner.seedState[next];
+            if (field[state] <= ticks) continue;
+            field[state] = ticks;
+            bucket[ticks % 3].push_back(state);
+            pending++;
+        }
+
+        vector<int> &current = bucket[ticks % 3];
+        for (size_t k = 0; k < current.size(); k++) {
+            int state = current[k];
+            if (field[state] != ticks) continue;   // improved after it was queued
+
+            int local = state / 4;
+            int exit  = state % 4;
+            int row   = local / route_cluster_size;
+            int col   = local % route_cluster_size;
+            unsigned int cost = entryCost(ctx.tileInfo[(firstRow + row) * ctx.number_column + firstCol + col]);
+
+            // The train came from the neighbour behind it, if that is in the cluster
+            row -= row_change[exit];
+            col -= column_change[exit];
+            if (row < 0 || row >= route_cluster_size || col < 0 || col >= route_cluster_size) continue;
+            if (!isInBounds(ctx, firstRow + row, firstCol + col)) continue;
+
+            const TileInfo &info = ctx.tileInfo[(firstRow + row) * ctx.number_column + firstCol + col];
+            int from = (row * route_cluster_size + col) * 4;
+            for (int h = 0; h < 4; h++) {
+                if (field[from + h] <= ticks + cost) continue;
+                if (!canExit(info, h, exit)) continue;
+                field[from + h] = ticks + cost;
+                bucket[(ticks + cost) % 3].push_back(from + h);
+                pending++;
+            }
+        }
+        pending -= current.size();
+        current.clear();
+        ticks++;
+    }
+    return slot;
+}
+
+// ----------------------------------------------------------------------------
+// Give the planner an empty cluster cache that fits `budget` bytes.
+// ----------------------------------------------------------------------------
+static void sizeClusterCache(RoutePlanner &planner, int clusters, size_t budget) {
+    size_t slotBytes = (size_t)cluster_states * sizeof(unsigned int);
+    size_t slots = budget / slotBytes;
+    if (slots < 9) slots = 9;                 // A cluster and its neighbours
+    if (slots > (size_t)clusters) slots = clusters;
+    planner.clusterSlot.assign(clusters, -1);
+    planner.slotCluster.assign(slots, -1);
+    planner.slotUsed.assign(slots, 0);
+    planner.slotTicks.resize(slots * cluster_states);
+    planner.clockHand = 0;
+}
+
+// ----------------------------------------------------------------------------
+// Build the planner with a cache sized to fit `budget` bytes.
+// ----------------------------------------------------------------------------
+static bool buildPlanner(SimulationContext &ctx, size_t budget) {
+    RoutePlanner *planner = new RoutePlanner;
+    planner->clusterColumns = (ctx.number_column + route_cluster_size - 1) / route_cluster_size;
+    int clusterRows = (ctx.number_rows + route_cluster_size - 1) / route_cluster_size;
+    int clusters = clusterRows * planner->clusterColumns;
+    buildPlannerGraph(ctx, *planner);
+    buildClusterSeeds(ctx, *planner, clusters);
+    sizeClusterCache(*planner, clusters, budget);
+    ctx.routePlanner = planner;
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Copy a planner for a fork.
+// ----------------------------------------------------------------------------
+// The abstract graph and seeds are copied; refined clusters are not, since
+// the fork fills its own cache as it goes.
+// ----------------------------------------------------------------------------
+bool copyRoutePlanner(const SimulationContext &from, SimulationContext &to, size_t budget) {
+    delete to.routePlanner;
+    const RoutePlanner &source = *from.routePlanner;
+    RoutePlanner *planner = new RoutePlanner;
+    planner->clusterColumns = source.clusterColumns;
+    planner->nodeState = source.nodeState;
+    planner->nodeTicks = source.nodeTicks;
+    planner->seedFirst = source.seedFirst;
+    planner->seedTicks = source.seedTicks;
+    planner->seedState = source.seedState;
+    sizeClusterCache(*planner, (int)source.clusterSlot.size(), budget);
+    to.routePlanner = planner;
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Ticks to delivery through the planner (see routeDistance).
+// ----------------------------------------------------------------------------
+int plannerDistance(const SimulationContext &ctx, int row, int col, int heading) {
+    RoutePlanner &planner = *ctx.routePlanner;
+    int cell    = row * ctx.number_column + col;
+    int cluster = clusterOf(ctx, cell);
+    int slot    = planner.clusterSlot[cluster];
+    if (slot == -1) slot = refineCluster(ctx, planner, cluster);
+    planner.slotUsed[slot] = 1;
+    unsigned int ticks = planner.slotTicks[(size_t)slot * cluster_states + localState(ctx, cell * 4 + heading)];
+    return ticks == planner_unreachable ? -1 : (int)ticks;
+}
+
+// ----------------------------------------------------------------------------
+// Build routing data for the loaded level.
+// ----------------------------------------------------------------------------
+bool buildRouteField(SimulationContext &ctx, size_t budget) {
+    releaseRouteField(ctx);
+    if (ctx.numDest == 0) return true;
+
+    size_t states = (size_t)ctx.number_rows * ctx.number_column * 4;
+    if (states * sizeof(unsigned short) <= budget) return buildFlatField(ctx);
+    return buildPlanner(ctx, budget);
+}
+
+// ----------------------------------------------------------------------------
+// Free the distance field and planner.
+// ----------------------------------------------------------------------------
+void releaseRouteField(SimulationContext &ctx) {
+    free(ctx.routeField);
+    ctx.routeField = 0;
+    delete ctx.routePlanner;
+    ctx.routePlanner = 0;
+}
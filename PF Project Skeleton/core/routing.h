@@ -0,0 +1,77 @@
+#ifndef ROUTING_H
+#define ROUTING_H
+
+// ============================================================================
+// ROUTING.H - Track routing tables
+// ============================================================================
+// How trains turn on each tile, and precomputed track distances to every
+// destination so routing decisions are table reads.
+// ============================================================================
+
+#include "simulation_state.h"
+
+// ----------------------------------------------------------------------------
+// TURN TABLE
+// ----------------------------------------------------------------------------
+// Outgoing direction for each (route class, incoming direction), generated at
+// compile time. route_dynamic marks switches and crossings, which depend on
+// switch state or the train's destination.
+// ----------------------------------------------------------------------------
+const signed char route_dynamic=-1;
+
+constexpr signed char turnFor(int tileClass, int dir) {
+    return (tileClass == tile_horizontal || tileClass == tile_spawn ||
+            tileClass == tile_destination || tileClass == tile_safety)
+               ? (signed char)(dir == left_dir ? left_dir : right_dir)
+         : (tileClass == tile_vertical)
+               ? (signed char)(dir == up_dir ? up_dir : down_dir)
+         : (tileClass == tile_right_curve)
+               ? (signed char)(dir == up_dir ? right_dir : dir == left_dir ? down_dir : dir)
+         : (tileClass == tile_left_curve)
+               ? (signed char)(dir == up_dir ? left_dir : dir == right_dir ? down_dir : dir)
+         : (tileClass == tile_crossing || tileClass == tile_switch)
+               ? route_dynamic
+               : (signed char)dir;   // empty/other: keep heading
+}
+
+#define TURN_ROW(c) { turnFor(c, 0), turnFor(c, 1), turnFor(c, 2), turnFor(c, 3) }
+static constexpr signed char turnTable[tile_other + 1][4] = {
+    TURN_ROW(0), TURN_ROW(1), TURN_ROW(2), TURN_ROW(3), TURN_ROW(4), TURN_ROW(5),
+    TURN_ROW(6), TURN_ROW(7), TURN_ROW(8), TURN_ROW(9), TURN_ROW(10)
+};
+#undef TURN_ROW
+static_assert(turnTable[tile_right_curve][up_dir] == right_dir, "turn table layout");
+static_assert(turnTable[tile_switch][up_dir] == route_dynamic, "turn table layout");
+
+// ----------------------------------------------------------------------------
+// DELIVERY DISTANCE
+// ----------------------------------------------------------------------------
+// Build routing data (after loading, or after the map changes).
+// Distances are the ticks a train standing on a tile, having arrived with a
+// given heading, needs to reach a destination tile. A train is delivered at
+// any destination, so one table serves every train.
+// Maps whose flat field fits `budget` bytes get one; larger maps get the
+// hierarchical planner, whose cluster cache is sized to the same budget.
+bool buildRouteField(SimulationContext &ctx, size_t budget = route_field_budget);
+
+// Free the distance field and planner.
+void releaseRouteField(SimulationContext &ctx);
+
+// Give `to` (a fork of `from`) its own planner with a `budget`-byte cache.
+bool copyRoutePlanner(const SimulationContext &from, SimulationContext &to, size_t budget);
+
+// Planner lookup used by routeDistance (refines the cluster on first use).
+int plannerDistance(const SimulationContext &ctx, int row, int col, int heading);
+
+// Ticks from (row,col) arriving with `heading` to the nearest destination,
+// or -1 when unknown (nothing built) or unreachable.
+inline int routeDistance(const SimulationContext &ctx, int row, int col, int heading) {
+    if (ctx.routeField) {
+        unsigned short ticks = ctx.routeField[((size_t)row * ctx.number_column + col) * 4 + heading];
+        return ticks == route_unreachable ? -1 : ticks;
+    }
+    if (ctx.routePlanner) return plannerDistance(ctx, row, col, heading);
+    return -1;
+}
+
+#endif
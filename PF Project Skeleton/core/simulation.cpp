@@ -13,43 +13,79 @@ using namespace std;
 // SIMULATION.CPP - Implementation of main simulation logic
 // ============================================================================
 
-void initializeSimulation() {
-    initializeSimulationState();
-    if(levelSeed != 0) srand(levelSeed);
-    else srand((unsigned int)time(0));
-    simulationRunning = 1;
-    currentTick = 0;
+void initializeSimulation(SimulationContext &ctx) {
+    initializeSimulationState(ctx);
+    if(ctx.levelSeed != 0) seedRandom(ctx, ctx.levelSeed);
+    else seedRandom(ctx, (unsigned int)time(0));
+    ctx.simulationRunning = 1;
+    ctx.currentTick = 0;
 }
 
-void simulateOneTick() {
-    if(!simulationRunning) return;
-
-    spawnTrainsForTick();
-    updateSwitchCounters();
-    queueSwitchFlips();
-    determineAllRoutes();
-    moveAllTrains();
-    applyDeferredFlips();
-    updateSignalLights();
-    applyEmergencyHalt();
-    updateEmergencyHalt();
-    checkArrivals();
-
-    currentTick++;
+void simulateOneTick(SimulationContext &ctx) {
+    if(!ctx.simulationRunning) return;
+
+    spawnTrainsForTick(ctx);
+    updateSwitchCounters(ctx);
+    queueSwitchFlips(ctx);
+    determineAllRoutes(ctx);
+    moveAllTrains(ctx);
+    applyDeferredFlips(ctx);
+    updateSignalLights(ctx);
+    applyEmergencyHalt(ctx);
+    updateEmergencyHalt(ctx);
+    checkArrivals(ctx);
+
+    ctx.currentTick++;
+}
+
+// ----------------------------------------------------------------------------
+// ADVANCE UNTIL NEXT EVENT
+// ----------------------------------------------------------------------------
+// A tick is quiet when no train spawns, no switch work is pending and every
+// active train is still waiting. Quiet ticks are applied in one step (or one
+// at a time when afterTick needs to see them); the tick cap is always left
+// to a real tick so completion is detected exactly as with simulateOneTick.
+// ----------------------------------------------------------------------------
+int advanceUntilNextEvent(SimulationContext &ctx, void (*afterTick)(const SimulationContext &ctx, void *data),
+                          void *afterTickData) {
+    if(!ctx.simulationRunning) return 0;
+
+    int quiet = 0;
+    if(ctx.numSwitchEntries==0&&ctx.numDueCounters==0&&ctx.numQueuedFlips==0){
+        quiet = quietTicksAhead(ctx);
+        for(int i=0;i<ctx.num_spawn;i++){
+            if(ctx.spawnTrainID[i]!=-1||ctx.spawnTick[i]<ctx.currentTick)continue;
+            if(ctx.spawnTick[i]-ctx.currentTick<quiet)quiet=ctx.spawnTick[i]-ctx.currentTick;
+        }
+        if(quiet>max_simulation_ticks-ctx.currentTick)quiet=max_simulation_ticks-ctx.currentTick;
+        if(quiet<0)quiet=0;
+    }
+
+    if(afterTick){
+        for(int t=0;t<quiet;t++){
+            skipQuietTicks(ctx, 1);
+            afterTick(ctx, afterTickData);
+        }
+    }
+    else skipQuietTicks(ctx, quiet);
+
+    simulateOneTick(ctx);
+    if(afterTick) afterTick(ctx, afterTickData);
+    return quiet + 1;
 }
 
 // ----------------------------------------------------------------------------
 // FIXED: CHECK IF SIMULATION IS COMPLETE
 // ----------------------------------------------------------------------------
-bool isSimulationComplete() {
+bool isSimulationComplete(const SimulationContext &ctx) {
     //Do not end at tick 0
-    if(currentTick==0)return false;
+    if(ctx.currentTick==0)return false;
     //End if trains reached+crashed= total trains spawned
-    if(num_spawn>0&&(trainsReached+crashed_trains)>=num_spawn){
+    if(ctx.num_spawn>0&&(ctx.trainsReached+ctx.crashed_trains)>=ctx.num_spawn){
         return true;
     }
     //Prevent infinite simulation
-    if(currentTick>1000)return true;
+    if(ctx.currentTick>max_simulation_ticks)return true;
 
     return false;
 }
\ No newline at end of file
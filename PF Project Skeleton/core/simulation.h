@@ -5,23 +5,36 @@
 // SIMULATION.H - Simulation tick logic
 // ============================================================================
 
+struct SimulationContext;
+
 // ----------------------------------------------------------------------------
 // MAIN SIMULATION FUNCTION
 // ----------------------------------------------------------------------------
 // Run one simulation tick.
-void simulateOneTick();
+void simulateOneTick(SimulationContext &ctx);
+
+// ----------------------------------------------------------------------------
+// EVENT STEPPING
+// ----------------------------------------------------------------------------
+// Skip the ticks in which nothing can change state, then run the next tick
+// where a spawn, wait or halt expiry, or movement can. afterTick (optional)
+// is called with `afterTickData` after every tick, skipped ones included, so
+// traces keep one entry per tick. Returns the number of ticks advanced.
+int advanceUntilNextEvent(SimulationContext &ctx,
+                          void (*afterTick)(const SimulationContext &ctx, void *data) = 0,
+                          void *afterTickData = 0);
 
 // ----------------------------------------------------------------------------
 // INITIALIZATION
 // ----------------------------------------------------------------------------
 // Initialize the simulation after loading a level.
-void initializeSimulation();
+void initializeSimulation(SimulationContext &ctx);
 
 // ----------------------------------------------------------------------------
 // UTILITY
 // ----------------------------------------------------------------------------
 // True if all trains are delivered or crashed.
-bool isSimulationComplete();
+bool isSimulationComplete(const SimulationContext &ctx);
 
 #endif
 
@@ -1,68 +1,319 @@
 #include "simulation_state.h"
+#include "routing.h"
+#include "track_graph.h"
 #include <cstring>
+#include <cstdlib>
+#include <cstdint>
 
 //Movement changes
 const int row_change[4]={-1,0,1,0};
 const int column_change[4]={0,1,0,-1};
 
-//Grid Variables
-int number_column;
-int number_rows;
-char grid[maximum_rows][maximum_Columns];
-int safetyDelay[maximum_rows][maximum_Columns];
-char originalGrid[maximum_rows][maximum_Columns];
-
-//Trains variables
-int numOf_trains;
-int trainRow[max_trains];
-int trainColumn[max_trains];
-int trainColor[max_trains];
-int trainDirection[max_trains];
-int trainWait[max_trains];
-
-//Switch Variables
-int numSwitches;
-char switchLetter[maximum_switches];
-int switchState[maximum_switches];
-int switchMode[maximum_switches];
-int switchCounter[maximum_switches][4];
-int switchK[maximum_switches][4];
-int switchFlipped[maximum_switches];
-int switchSignal[maximum_switches];
-
-//Spawn point variables
-int num_spawn;
-int spawnn_Row[max_trains];
-int spawnn_Column[max_trains];
-int spawnTick[max_trains];
-int spawnTrainID[max_trains];
-int spawnDirection[max_trains];
-int spawnColor[max_trains];
-
-//Destination point variables
-int numDest;
-int destinationRow[max_trains];
-int destinationColumn[max_trains];
-int destinationTrainID[max_trains];
-
-//Simulation parameters
-int currentTick;
-int totalTicks;
-int levelSeed;
-int weather_type;
-int simulationRunning;
-
-//Data metric
-int trainsReached;
-int crashed_trains;
-int totalWaitTicks;
-int T_energy;
-int switchFlips;
-int signalViolations;
-
-//Emergency halt
-int emergencyHalt[maximum_rows][maximum_Columns];
-int emergencyHaltActive;
+// ============================================================================
+// SIMULATION CONTEXT
+// ============================================================================
+SimulationContext::SimulationContext(){
+    worldArena=0;
+    worldArenaSize=0;
+    routeField=0;
+    routePlanner=0;
+    trackGraph=0;
+    levelOwner=0;
+    levelForks=0;
+    levelArena=0;
+    initializeSimulationState(*this);
+}
+
+SimulationContext::~SimulationContext(){
+    releaseWorld(*this);
+}
+
+// ============================================================================
+// WORLD ARENA
+// ============================================================================
+// ----------------------------------------------------------------------------
+// Arena layout helpers.
+// ----------------------------------------------------------------------------
+// Every array starts on its own cache line so small levels keep the same
+// tight, aligned layout the fixed arrays used to have.
+// ----------------------------------------------------------------------------
+static const size_t arena_alignment=64;
+
+static size_t alignArena(size_t offset){
+    return (offset+arena_alignment-1)&~(arena_alignment-1);
+}
+
+static void* carveArena(char *base,size_t &offset,size_t bytes){
+    offset=alignArena(offset);
+    void *block=base?base+offset:0;
+    offset+=bytes;
+    return block;
+}
+
+// ----------------------------------------------------------------------------
+// Lay out the map arrays.
+// ----------------------------------------------------------------------------
+// Points the map arrays (grid, originalGrid, safetyDelay, tileInfo) into
+// base and returns the bytes used. With base==0 nothing is assigned and only
+// the size is computed.
+// ----------------------------------------------------------------------------
+static size_t layoutLevel(SimulationContext &ctx,char *base,size_t offset,int rows,int columns){
+    size_t cells=(size_t)rows*(size_t)columns;
+
+    char **gridRows=(char**)carveArena(base,offset,rows*sizeof(char*));
+    char **originalRows=(char**)carveArena(base,offset,rows*sizeof(char*));
+    int **delayRows=(int**)carveArena(base,offset,rows*sizeof(int*));
+    char *gridCells=(char*)carveArena(base,offset,cells*sizeof(char));
+    char *originalCells=(char*)carveArena(base,offset,cells*sizeof(char));
+    int *delayCells=(int*)carveArena(base,offset,cells*sizeof(int));
+    TileInfo *infoCells=(TileInfo*)carveArena(base,offset,cells*sizeof(TileInfo));
+    if(!base) return offset;
+
+    ctx.grid=gridRows;
+    ctx.originalGrid=originalRows;
+    ctx.safetyDelay=delayRows;
+    for(int i=0;i<rows;i++){
+        ctx.grid[i]=gridCells+(size_t)i*columns;
+        ctx.originalGrid[i]=originalCells+(size_t)i*columns;
+        ctx.safetyDelay[i]=delayCells+(size_t)i*columns;
+    }
+    memset(gridCells,space,cells);
+    memset(originalCells,space,cells);
+    memset(delayCells,0,cells*sizeof(int));
+    for(size_t c=0;c<cells;c++){
+        infoCells[c].tileClass=tile_empty;
+        infoCells[c].routeClass=tile_empty;
+        infoCells[c].trackMask=0;
+        infoCells[c].openMask=0;
+        infoCells[c].switchIndex=-1;
+        infoCells[c].pointMask=0;
+        infoCells[c].segment=-1;
+    }
+    ctx.tileInfo=infoCells;
+    return offset;
+}
+
+// ----------------------------------------------------------------------------
+// Lay out the world arrays.
+// ----------------------------------------------------------------------------
+// Points every per-level array into base and returns the bytes used. Forks
+// leave out the map arrays (withLevel=false), which they share.
+// With base==0 nothing is assigned and only the size is computed.
+// ----------------------------------------------------------------------------
+static size_t layoutWorld(SimulationContext &ctx,char *base,int rows,int columns,int trains,bool withLevel){
+    size_t cells=(size_t)rows*(size_t)columns;
+    size_t trainBytes=(size_t)trains*sizeof(int);
+    size_t offset=base?(size_t)(alignArena((uintptr_t)base)-(uintptr_t)base):0;
+
+    if(withLevel) offset=layoutLevel(ctx,base,offset,rows,columns);
+    int **haltRows=(int**)carveArena(base,offset,rows*sizeof(int*));
+    int *haltCells=(int*)carveArena(base,offset,cells*sizeof(int));
+    TileIndex *indexCells=(TileIndex*)carveArena(base,offset,cells*sizeof(TileIndex));
+
+    int *trainArrays[24];
+    for(int k=0;k<24;k++){
+        trainArrays[k]=(int*)carveArena(base,offset,trainBytes);
+    }
+    offset+=arena_alignment;
+    if(!base) return offset;
+
+    ctx.emergencyHalt=haltRows;
+    for(int i=0;i<rows;i++){
+        ctx.emergencyHalt[i]=haltCells+(size_t)i*columns;
+    }
+    memset(haltCells,0,cells*sizeof(int));
+    for(size_t c=0;c<cells;c++){
+        indexCells[c].stamp=0;
+    }
+    ctx.tileIndex=indexCells;
+    ctx.collisionIndexStamp=0;
+    ctx.numHaltZones=0;
+    ctx.emergencyHaltActive=0;
+    ctx.numSwitchEntries=0;
+    ctx.numDueCounters=0;
+    ctx.numQueuedFlips=0;
+
+    int k=0;
+    ctx.trainRow=trainArrays[k++];
+    ctx.trainColumn=trainArrays[k++];
+    ctx.trainColor=trainArrays[k++];
+    ctx.trainDirection=trainArrays[k++];
+    ctx.trainWait=trainArrays[k++];
+    ctx.plannedRow=trainArrays[k++];
+    ctx.plannedColumn=trainArrays[k++];
+    ctx.plannedDirection=trainArrays[k++];
+    ctx.previousRow=trainArrays[k++];
+    ctx.previousColumn=trainArrays[k++];
+    ctx.plannedOnSegment=trainArrays[k++];
+    ctx.plannedLink=trainArrays[k++];
+    ctx.occupantLink=trainArrays[k++];
+    ctx.spawnn_Row=trainArrays[k++];
+    ctx.spawnn_Column=trainArrays[k++];
+    ctx.spawnTick=trainArrays[k++];
+    ctx.spawnTrainID=trainArrays[k++];
+    ctx.spawnDirection=trainArrays[k++];
+    ctx.spawnColor=trainArrays[k++];
+    ctx.destinationRow=trainArrays[k++];
+    ctx.destinationColumn=trainArrays[k++];
+    ctx.destinationTrainID=trainArrays[k++];
+    ctx.trainDestination=trainArrays[k++];
+    ctx.switchEntries=trainArrays[k++];
+    return offset;
+}
+
+// ----------------------------------------------------------------------------
+// Default every train, spawn and destination slot.
+// ----------------------------------------------------------------------------
+static void resetTrainSlots(SimulationContext &ctx){
+    for(int i=0;i<ctx.trainCapacity;i++){
+        ctx.trainRow[i]=-1;
+        ctx.trainColumn[i]=-1;
+        ctx.trainDirection[i]=train_right;
+        ctx.trainColor[i]=0;
+        ctx.trainWait[i]=0;
+        ctx.spawnn_Row[i]=-1;
+        ctx.spawnn_Column[i]=-1;
+        ctx.spawnTick[i]=0;
+        ctx.spawnTrainID[i]=-1;
+        ctx.spawnDirection[i]=train_right; //Default direction for train
+        ctx.spawnColor[i]=0;
+        ctx.destinationRow[i]=-1;
+        ctx.destinationColumn[i]=-1;
+        ctx.destinationTrainID[i]=-1;
+        ctx.trainDestination[i]=-1;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Stop reading another context's level.
+// ----------------------------------------------------------------------------
+// Borrowed pointers are dropped, not freed. Also frees a detached fork's
+// own level arrays.
+// ----------------------------------------------------------------------------
+static void releaseLevel(SimulationContext &ctx){
+    if(ctx.levelOwner){
+        ctx.routeField=0;
+        ctx.trackGraph=0;
+        ctx.levelOwner->levelForks--;
+        ctx.levelOwner=0;
+    }
+    free(ctx.levelArena);
+    ctx.levelArena=0;
+}
+
+// ----------------------------------------------------------------------------
+// Size the world for a level.
+// ----------------------------------------------------------------------------
+// Lays out all per-level arrays in one block and fills them with defaults.
+// ----------------------------------------------------------------------------
+bool allocateWorld(SimulationContext &ctx, int rows,int columns,int trains){
+    if(rows<0||columns<0||trains<0) return false;
+    size_t cells=(size_t)rows*(size_t)columns;
+    if(columns>0&&cells/(size_t)columns!=(size_t)rows) return false;
+
+    //The distance field and track graph belong to the previous level
+    releaseLevel(ctx);
+    releaseRouteField(ctx);
+    releaseTrackGraph(ctx);
+
+    //Reuse the block when the level fits
+    size_t needed=layoutWorld(ctx,0,rows,columns,trains,true);
+    if(needed>ctx.worldArenaSize){
+        releaseWorld(ctx);
+        ctx.worldArena=(char*)malloc(needed);
+        if(!ctx.worldArena) return false;
+        ctx.worldArenaSize=needed;
+    }
+    layoutWorld(ctx,ctx.worldArena,rows,columns,trains,true);
+
+    ctx.number_rows=rows;
+    ctx.number_column=columns;
+    ctx.trainCapacity=trains;
+    resetTrainSlots(ctx);
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Size a fork that reads another context's level.
+// ----------------------------------------------------------------------------
+bool shareWorld(SimulationContext &fork, SimulationContext &owner){
+    releaseLevel(fork);
+    releaseRouteField(fork);
+    releaseTrackGraph(fork);
+
+    int rows=owner.number_rows;
+    int columns=owner.number_column;
+    int trains=owner.trainCapacity;
+    size_t needed=layoutWorld(fork,0,rows,columns,trains,false);
+    if(needed>fork.worldArenaSize){
+        releaseWorld(fork);
+        fork.worldArena=(char*)malloc(needed);
+        if(!fork.worldArena) return false;
+        fork.worldArenaSize=needed;
+    }
+    layoutWorld(fork,fork.worldArena,rows,columns,trains,false);
+
+    fork.number_rows=rows;
+    fork.number_column=columns;
+    fork.trainCapacity=trains;
+    resetTrainSlots(fork);
+
+    //A fork of a fork reads the same level as its parent
+    SimulationContext *root=owner.levelOwner?owner.levelOwner:&owner;
+    fork.grid=owner.grid;
+    fork.originalGrid=owner.originalGrid;
+    fork.safetyDelay=owner.safetyDelay;
+    fork.tileInfo=owner.tileInfo;
+    fork.routeField=owner.routeField;
+    fork.trackGraph=owner.trackGraph;
+    fork.levelOwner=root;
+    root->levelForks++;
+
+    //The planner's cluster cache changes on every lookup, so forks get their own
+    if(owner.routePlanner) return copyRoutePlanner(owner,fork,route_fork_cache_budget);
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Copy a fork's level before its map is edited.
+// ----------------------------------------------------------------------------
+bool detachLevel(SimulationContext &ctx){
+    if(!ctx.levelOwner) return true;
+
+    int rows=ctx.number_rows;
+    int columns=ctx.number_column;
+    size_t cells=(size_t)rows*(size_t)columns;
+    char *arena=(char*)malloc(layoutLevel(ctx,0,0,rows,columns)+arena_alignment);
+    if(!arena) return false;
+
+    char **grid=ctx.grid;
+    char **originalGrid=ctx.originalGrid;
+    int **safetyDelay=ctx.safetyDelay;
+    const TileInfo *tileInfo=ctx.tileInfo;
+    layoutLevel(ctx,arena,(size_t)(alignArena((uintptr_t)arena)-(uintptr_t)arena),rows,columns);
+    if(cells>0){
+        memcpy(ctx.grid[0],grid[0],cells*sizeof(char));
+        memcpy(ctx.originalGrid[0],originalGrid[0],cells*sizeof(char));
+        memcpy(ctx.safetyDelay[0],safetyDelay[0],cells*sizeof(int));
+        memcpy(ctx.tileInfo,tileInfo,cells*sizeof(TileInfo));
+    }
+
+    releaseLevel(ctx);
+    ctx.levelArena=arena;
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Free the world arena.
+// ----------------------------------------------------------------------------
+void releaseWorld(SimulationContext &ctx){
+    releaseLevel(ctx);
+    releaseRouteField(ctx);
+    releaseTrackGraph(ctx);
+    free(ctx.worldArena);
+    ctx.worldArena=0;
+    ctx.worldArenaSize=0;
+}
 // ============================================================================
 // INITIALIZE SIMULATION STATE
 // ============================================================================
@@ -74,86 +325,81 @@ int emergencyHaltActive;
     // ============================================================================
 // SIMULATION_STATE.CPP - Global state definitions
 // ============================================================================
-void initializeSimulationState(){
+void initializeSimulationState(SimulationContext &ctx){
 // ----------------------------------------------------------------------------
 // GRID
 // ----------------------------------------------------------------------------
-    number_column=0;
-    number_rows=0;
-    for(int i=0;i<maximum_rows;i++){
-        for(int j=0;j<maximum_Columns;j++){
-            grid[i][j]=space;
-            safetyDelay[i][j] = 0;
-        }
-    }
+    //An empty world; loadLevelFile sizes it for the level
+    allocateWorld(ctx, 0,0,0);
 
 // ----------------------------------------------------------------------------
 // TRAINS
 // ----------------------------------------------------------------------------
-    numOf_trains=0;
-    for(int i=0;i<max_trains;i++){
-        trainRow[i]=-1;
-        trainColumn[i]=-1;
-        trainDirection[i]=train_right;
-        trainColor[i]=0;
-        trainWait[i]=0; 
-    }
+    ctx.numOf_trains=0;
 
 // ----------------------------------------------------------------------------
 // SWITCHES
 // ----------------------------------------------------------------------------
-    numSwitches=0;
+    ctx.numSwitches=0;
     for(int i=0;i<maximum_switches;i++){
-        switchLetter[i]='A'+i;
-        switchState[i]=0;
-        switchMode[i]=switchmode_per_dir;
-        switchFlipped[i]=0;
-        switchSignal[i] = signal_green;
+        ctx.switchLetter[i]='A'+i;
+        ctx.switchState[i]=0;
+        ctx.switchMode[i]=switchmode_per_dir;
+        ctx.switchFlipped[i]=0;
+        ctx.switchSignal[i] = signal_green;
         for(int j=0;j<4;j++){
-            switchCounter[i][j]=0;
-            switchK[i][j]=0;
+            ctx.switchCounter[i][j]=0;
+            ctx.switchK[i][j]=0;
         }
     }
+    ctx.numSwitchEntries=0;
+    ctx.numDueCounters=0;
+    ctx.numQueuedFlips=0;
 // ----------------------------------------------------------------------------
 // SPAWN AND DESTINATION POINTS
 // ----------------------------------------------------------------------------
-    num_spawn=0;
-    numDest=0;
-    for(int i=0;i<max_trains;i++){
-        spawnn_Row[i]=-1;
-        spawnn_Column[i]=-1;
-        spawnTick[i]=0;
-        spawnTrainID[i]=-1;
-        spawnDirection[i]=train_right; //Default direction for train
-        spawnColor[i]=0; 
-        destinationRow[i]=-1;
-        destinationColumn[i]=-1;
-        destinationTrainID[i]=-1;
-    }
+    ctx.num_spawn=0;
+    ctx.numDest=0;
 // ----------------------------------------------------------------------------
 // SIMULATION PARAMETERS
 // ----------------------------------------------------------------------------
-    currentTick=0;
-    totalTicks=0;
-    levelSeed=0;
-    weather_type=weather_normal;
-    simulationRunning=0;
+    ctx.currentTick=0;
+    ctx.totalTicks=0;
+    ctx.levelSeed=0;
+    ctx.levelHash=0;
+    ctx.weather_type=weather_normal;
+    ctx.simulationRunning=0;
 // ----------------------------------------------------------------------------
 // METRICS
 // ----------------------------------------------------------------------------
-    trainsReached=0;
-    crashed_trains=0;
-    totalWaitTicks=0;
-    T_energy=0;
-    switchFlips=0;
-    signalViolations=0;
+    ctx.trainsReached=0;
+    ctx.crashed_trains=0;
+    ctx.totalWaitTicks=0;
+    ctx.T_energy=0;
+    ctx.switchFlips=0;
+    ctx.signalViolations=0;
 // ----------------------------------------------------------------------------
 // EMERGENCY HALT
 // ----------------------------------------------------------------------------
-    emergencyHaltActive=0;
-    for(int i=0;i<maximum_rows;i++){
-        for(int j=0;j<maximum_Columns;j++){
-            emergencyHalt[i][j]=0;
-        }
-    }
+    ctx.emergencyHaltActive=0;
+    ctx.numHaltZones=0;
+    seedRandom(ctx,1);
+}
+
+// ============================================================================
+// RANDOM NUMBERS
+// ============================================================================
+// ----------------------------------------------------------------------------
+// Per-context random stream.
+// ----------------------------------------------------------------------------
+// Same linear congruential step as the classic C library rand(), but the
+// state lives in the context so simulations do not disturb each other.
+// ----------------------------------------------------------------------------
+void seedRandom(SimulationContext &ctx,unsigned int seed){
+    ctx.rngState=seed;
+}
+
+int nextRandom(SimulationContext &ctx){
+    ctx.rngState=ctx.rngState*1103515245u+12345u;
+    return (int)((ctx.rngState/65536u)%32768u);
 }
@@ -4,15 +4,18 @@
 // ============================================================================
 // SIMULATION_STATE.H - Global constants and state
 // ============================================================================
-// Global constants and arrays used by the game.
+// Global constants and the per-simulation state context used by the game.
 // ============================================================================
+#include <atomic>
+#include <cstddef>
+
+struct RoutePlanner;
+struct TrackGraph;
 
 // ----------------------------------------------------------------------------
 // GRID CONSTANTS
 // ----------------------------------------------------------------------------
-//Grid Size
-const int maximum_rows=70;
-const int maximum_Columns=70;
+//Grid Size is set per level by loadLevelFile (see allocateWorld)
 //Tiles
 const char space=' ';
 const char horizontal_track='-';
@@ -30,12 +33,26 @@ const int left_dir=3;
 //Movement changes
 extern const int row_change[4];
 extern const int column_change[4];
+//Tile classes (see TileInfo)
+const unsigned char tile_empty=0;
+const unsigned char tile_horizontal=1;
+const unsigned char tile_vertical=2;
+const unsigned char tile_right_curve=3;
+const unsigned char tile_left_curve=4;
+const unsigned char tile_crossing=5;
+const unsigned char tile_spawn=6;
+const unsigned char tile_destination=7;
+const unsigned char tile_safety=8;
+const unsigned char tile_switch=9;
+const unsigned char tile_other=10;   //Any other character (scenery, labels)
+//TileInfo point flags
+const unsigned char point_spawn=1;
+const unsigned char point_destination=2;
 
 
 // ----------------------------------------------------------------------------
 // TRAIN CONSTANTS
 // ----------------------------------------------------------------------------
-const int max_trains=20;
 const int max_colors=10;
 //Train Directions
 const int train_up=0;
@@ -50,7 +67,7 @@ const int train_speed_delay=1;
 // ----------------------------------------------------------------------------
 // SWITCH CONSTANTS
 // ----------------------------------------------------------------------------
-const int maximum_switches=26;
+const int maximum_switches=26;           //One slot per switch letter A-Z
 const int max_switches_state=2;
 const char start_switch='A';
 const char end_switch='Z';
@@ -61,6 +78,34 @@ const int PER_DIR=0;
 const int GLOBAL=1;
 const int switchmode_per_dir=PER_DIR;     //Number of modes a switch can have per direction
 
+// ----------------------------------------------------------------------------
+// EMERGENCY HALT CONSTANTS
+// ----------------------------------------------------------------------------
+const int max_halt_zones=64;          //Zones active at the same time
+const int emergency_halt_radius=1;    //Zone is (2r+1)x(2r+1) tiles: 3x3
+const int emergency_halt_ticks=3;     //Halt length for crash-triggered zones
+
+// ----------------------------------------------------------------------------
+// TICK CONSTANTS
+// ----------------------------------------------------------------------------
+const int max_simulation_ticks=1000;          //Runs end once past this tick
+const int quiet_ticks_unbounded=0x7FFFFFFF;   //No active train limits a skip
+
+// ----------------------------------------------------------------------------
+// ROUTING CONSTANTS
+// ----------------------------------------------------------------------------
+const unsigned short route_unreachable=0xFFFF;      //Distance field: no path
+const size_t route_field_budget=(size_t)64<<20;     //Max bytes of the distance field
+const int route_cluster_size=32;                    //Planner cluster edge in tiles
+const size_t route_fork_cache_budget=(size_t)8<<20; //Planner cluster cache of each fork
+
+// ----------------------------------------------------------------------------
+// LOGGING CONSTANTS
+// ----------------------------------------------------------------------------
+const size_t log_buffer_bytes=(size_t)1<<20;        //Rows batched per log file
+const size_t log_ring_records=(size_t)1<<15;        //Async ring slots (power of 2)
+const int log_keyframe_ticks=100;                   //Delta logging keyframe spacing
+
 // ----------------------------------------------------------------------------
 // WEATHER CONSTANTS
 // ----------------------------------------------------------------------------
@@ -68,6 +113,7 @@ const int weather_normal=0;
 const int weather_rain=1;
 const int weather_fog=2;
 const int weather_types=3;
+const int rain_slowdown_chance=5;     //RAIN: a moving train is slowed 1 move in N
 
 // ----------------------------------------------------------------------------
 // SIGNAL CONSTANTS
@@ -79,91 +125,214 @@ const int max_signals=3;
 
 
 // ----------------------------------------------------------------------------
-// GLOBAL STATE: GRID
+// TILE RECORDS
+// ----------------------------------------------------------------------------
+// Precomputed per-tile data so movement queries are lookups instead of
+// character tests. Built by buildTileInfo at load, kept current by
+// refreshTileInfo whenever a tile changes.
+struct TileInfo{
+    unsigned char tileClass;   //tile_* class of the current character
+    unsigned char routeClass;  //Class used for turning ('=' reads the tile underneath)
+    unsigned char trackMask;   //Bit d set: neighbour in direction d can be entered
+    unsigned char openMask;    //Bit d set: neighbour in direction d is not empty
+    signed char switchIndex;   //Letter index 0-25 for 'A'..'Z' tiles, else -1
+    unsigned char pointMask;   //point_spawn/point_destination if listed there
+    int segment;               //Track segment of a straight run (track_graph.h), else -1
+};
+
+// Collision index entry of one tile, rebuilt every tick by moveAllTrains.
+// Heads start ascending train lists linked through plannedLink/occupantLink.
+struct TileIndex{
+    int stamp;                 //Heads are valid when equal to collisionIndexStamp
+    int plannedHead;           //Trains planning to enter the tile
+    int occupantHead;          //Trains standing on the tile
+};
+
+
+// ============================================================================
+// SIMULATION CONTEXT
+// ============================================================================
+// Owns every piece of state one simulation mutates: grid, trains, switches,
+// spawns, metrics and RNG. Each context is independent, so several
+// simulations can run in one process (one per thread).
+// Contexts own their world arena and cannot be copied; forkSimulation
+// (fork.h) starts one from another that shares its level data.
+// ============================================================================
+struct SimulationContext{
+// ----------------------------------------------------------------------------
+// GRID
 // ----------------------------------------------------------------------------
-extern int number_column;
-extern int number_rows;
-extern char grid[maximum_rows][maximum_Columns];
-extern int safetyDelay[maximum_rows][maximum_Columns];    //Remaining ticks on a =tile 
-extern char originalGrid[maximum_rows][maximum_Columns]; //Original grid for resetting safety tiles
+// Grid arrays are row pointers into the world arena, so they are still
+// indexed as grid[row][col]. Rows are packed back to back (stride = COLS).
+    int number_column;
+    int number_rows;
+    char **grid;
+    int **safetyDelay;    //Remaining ticks on a =tile 
+    char **originalGrid; //Original grid for resetting safety tiles
+    TileInfo *tileInfo;  //Per-tile records, indexed row*number_column+col
+    TrackGraph *trackGraph;  //Straight-run segments (track_graph.cpp), separate heap block
 
 // ----------------------------------------------------------------------------
-// GLOBAL STATE: TRAINS
+// TRAINS
 // ----------------------------------------------------------------------------
-extern int numOf_trains;
-extern int trainRow[max_trains];       //Row index of each train
-extern int trainColumn[max_trains];    //Column index of each train
-extern int trainColor[max_trains];
-extern int trainDirection[max_trains];
-extern int trainWait[max_trains]; //Ticks left to wait
+    int numOf_trains;
+    int trainCapacity;    //Train slots in the arena (one per TRAINS entry)
+    int *trainRow;       //Row index of each train
+    int *trainColumn;    //Column index of each train
+    int *trainColor;
+    int *trainDirection;
+    int *trainWait; //Ticks left to wait
+    //Scratch used by moveAllTrains to plan a tick's moves
+    int *plannedRow;
+    int *plannedColumn;
+    int *plannedDirection;
+    int *previousRow;
+    int *previousColumn;
+    int *plannedOnSegment;   //1: moved by the segment fast path (no conflicts), -1: shares a tile
+    //Per-tile collision index rebuilt while planning moves: ascending train
+    //lists of who plans to enter and who stands on each tile
+    TileIndex *tileIndex;
+    int *plannedLink;
+    int *occupantLink;
+    int collisionIndexStamp;
 
 // ----------------------------------------------------------------------------
-// GLOBAL STATE: SWITCHES (A-Z mapped to 0-25)
+// SWITCHES (A-Z mapped to 0-25)
 // ----------------------------------------------------------------------------
-extern int numSwitches;
-extern int switchSignal[maximum_switches];
-extern char switchLetter[maximum_switches];
-extern int switchState[maximum_switches];
-extern int switchMode[maximum_switches];
-extern int switchCounter[maximum_switches][4];//Counter for perdirection for each switch(0,1,2,3)
-extern int switchK[maximum_switches][4];//K value for each switch perdirection(entries left before flip)
-extern int switchFlipped[maximum_switches];//Check if switch will flip
-extern int switchRouting[maximum_switches][4][2];
+    int numSwitches;
+    int switchSignal[maximum_switches];
+    char switchLetter[maximum_switches];
+    int switchState[maximum_switches];
+    int switchMode[maximum_switches];
+    int switchCounter[maximum_switches][4];//Counter for perdirection for each switch(0,1,2,3)
+    int switchK[maximum_switches][4];//K value for each switch perdirection(entries left before flip)
+    int switchFlipped[maximum_switches];//Check if switch will flip
+    //Event lists so switch phases only touch switches that saw traffic
+    int *switchEntries;      //Trains that moved onto a switch last move (one slot per train)
+    int numSwitchEntries;
+    int dueCounters[maximum_switches*4];   //switch*4+dir of counters that reached K
+    int numDueCounters;
+    int flipQueue[maximum_switches];       //Switches with switchFlipped set
+    int numQueuedFlips;
 
+// ----------------------------------------------------------------------------
+// SPAWN POINTS
+// ----------------------------------------------------------------------------
+    int num_spawn;
+    //Spawn Position
+    int *spawnn_Row;
+    int *spawnn_Column;
+    //Tick for Spawn of Train
+    int *spawnTick;
+    //Train index on spawn point
+    int *spawnTrainID;
+    int *spawnDirection;
+    int *spawnColor;
 
 // ----------------------------------------------------------------------------
-// GLOBAL STATE: SPAWN POINTS
+// DESTINATION POINTS
 // ----------------------------------------------------------------------------
-extern int num_spawn;
-//Spawn Position
-extern int spawnn_Row[max_trains];
-extern int spawnn_Column[max_trains];
-//Tick for Spawn of Train
-extern int spawnTick[max_trains];
-//Train index on spawn point
-extern int spawnTrainID[max_trains];
-extern int spawnDirection[max_trains];
-extern int spawnColor[max_trains];
+    int numDest;
+    //Destination Position
+    int *destinationRow;
+    int *destinationColumn;
+    //Train index for destination
+    int *destinationTrainID;
+    //Per train slot: lowest d with destinationTrainID[d]==slot, else -1
+    int *trainDestination;
+    //Ticks to the nearest destination per tile and heading (routing.cpp).
+    //Separate heap blocks, null when not built; large maps use the planner
+    unsigned short *routeField;
+    RoutePlanner *routePlanner;
 
 // ----------------------------------------------------------------------------
-// GLOBAL STATE: DESTINATION POINTS
+// SIMULATION PARAMETERS
 // ----------------------------------------------------------------------------
-extern int numDest;
-//Destination Position
-extern int destinationRow[max_trains];
-extern int destinationColumn[max_trains];
-//Train index for destination
-extern int destinationTrainID[max_trains];
+    int currentTick;
+    int totalTicks;
+    int levelSeed;
+    unsigned long long levelHash;   //FNV-1a of the level file (trace headers)
+    int weather_type;
+    int simulationRunning;
+    unsigned int rngState;   //Per-simulation random stream (see nextRandom)
 
 // ----------------------------------------------------------------------------
-// GLOBAL STATE: SIMULATION PARAMETERS
+// METRICS
 // ----------------------------------------------------------------------------
-extern int currentTick;
-extern int totalTicks;
-extern int levelSeed;
-extern int weather_type;
-extern int simulationRunning;
+    int trainsReached;
+    int crashed_trains;
+    int totalWaitTicks;
+    int T_energy;
+    int switchFlips;
+    int signalViolations;
 
 // ----------------------------------------------------------------------------
-// GLOBAL STATE: METRICS
+// EMERGENCY HALT
 // ----------------------------------------------------------------------------
-extern int trainsReached;
-extern int crashed_trains;
-extern int totalWaitTicks;
-extern int T_energy;
-extern int switchFlips;
-extern int signalViolations;
+    int **emergencyHalt;  //Tick each tile's halt ends (halted while > currentTick)
+    int emergencyHaltActive;
+    //Active zones (centre tile and end tick), so ticks only visit live zones
+    int numHaltZones;
+    int haltZoneRow[max_halt_zones];
+    int haltZoneColumn[max_halt_zones];
+    int haltZoneExpiry[max_halt_zones];
 
 // ----------------------------------------------------------------------------
-// GLOBAL STATE: EMERGENCY HALT
+// WORLD ARENA
 // ----------------------------------------------------------------------------
-extern int emergencyHalt[maximum_rows][maximum_Columns];  //Ticks remaining for halt
-extern int emergencyHaltActive;
+    char *worldArena;
+    size_t worldArenaSize;
+    //A fork (fork.h) reads the level of the context it was forked from:
+    //grid, originalGrid, safetyDelay, tileInfo, routeField and trackGraph
+    //point into levelOwner until detachLevel copies them before an edit
+    SimulationContext *levelOwner;   //Context whose level this one reads, else null
+    std::atomic<int> levelForks;     //Forks reading this context's level
+    char *levelArena;                //Level arrays of a detached fork
+
+    SimulationContext();
+    ~SimulationContext();
+    SimulationContext(const SimulationContext&)=delete;
+    SimulationContext& operator=(const SimulationContext&)=delete;
+};
 
 // ----------------------------------------------------------------------------
 // INITIALIZATION FUNCTION
 // ----------------------------------------------------------------------------
 // Resets all state before loading a new level.
-void initializeSimulationState();
+void initializeSimulationState(SimulationContext &ctx);
+
+// ----------------------------------------------------------------------------
+// WORLD ARENA
+// ----------------------------------------------------------------------------
+// Sizes the world for a level: every grid, train, spawn and destination array
+// is carved out of one contiguous block and reset to its default value.
+// The block is kept and reused when the next level fits into it.
+// Returns false if the sizes are invalid or memory is exhausted.
+bool allocateWorld(SimulationContext &ctx,int rows,int columns,int trains);
+
+// Frees the world arena.
+void releaseWorld(SimulationContext &ctx);
+
+// Sizes `fork` like `owner` with its own arrays for everything a run changes
+// (filled with defaults) and points its level data at owner's. The owner
+// must outlive the fork and keep its level; its map cannot be edited while
+// forks read it. Returns false if memory is exhausted.
+bool shareWorld(SimulationContext &fork, SimulationContext &owner);
+
+// Copy-on-write for forks: copies the level arrays into the context's own
+// memory before its map is edited. The shared distance field and track
+// graph are dropped (set to null) for the caller to rebuild. Does nothing
+// for a context that owns its level. Returns false if memory is exhausted.
+bool detachLevel(SimulationContext &ctx);
+
+// ----------------------------------------------------------------------------
+// RANDOM NUMBERS
+// ----------------------------------------------------------------------------
+// Seeds the context's random stream.
+void seedRandom(SimulationContext &ctx,unsigned int seed);
+
+// Next value (0..32767) from the context's random stream. Replaces rand(),
+// whose hidden global state cannot be shared between simulations.
+int nextRandom(SimulationContext &ctx);
 
 #endif
\ No newline at end of file
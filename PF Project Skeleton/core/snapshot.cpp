@@ -0,0 +1,426 @@
+#include "snapshot.h"
+#include "simulation_state.h"
+#include "grid.h"
+#include "routing.h"
+#include "track_graph.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+using namespace std;
+
+// ============================================================================
+// SNAPSHOT.CPP - Simulation snapshots
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// LAYOUT
+// ----------------------------------------------------------------------------
+// A header, then a payload of int32 values in the order writePayload lists
+// them. Lists carry their length first. Host byte order, like the level
+// cache. Halts are stored only while they can still hold a train, and only
+// tiles that differ from the loaded map are stored.
+// ----------------------------------------------------------------------------
+static const char snapshot_magic[8]={'S','B','S','N','A','P','\0','\0'};
+static const uint32_t snapshot_version=1;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t payloadValues;         // int32 values after the header
+    uint64_t levelHash;             // Must match the context restored into
+    uint64_t checksum;              // FNV-1a of the payload bytes
+    int32_t rows;
+    int32_t columns;
+    int32_t trainCapacity;
+    int32_t numSwitches;
+    int32_t numSpawns;
+    int32_t numDestinations;
+};
+
+static uint64_t checksumBytes(const char *bytes, size_t count) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t k = 0; k < count; k++) {
+        hash ^= (unsigned char)bytes[k];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// A tile differs from the loaded map (edited with toggleSafetyTile)
+static bool tileEdited(const SimulationContext &ctx, int cell) {
+    int r = cell / ctx.number_column, c = cell % ctx.number_column;
+    return ctx.grid[r][c] != ctx.originalGrid[r][c] || ctx.safetyDelay[r][c] != 0;
+}
+
+// Put an edited tile back as loaded. Returns true if it was edited.
+static bool revertTile(SimulationContext &ctx, int cell) {
+    if (!tileEdited(ctx, cell)) return false;
+    int r = cell / ctx.number_column, c = cell % ctx.number_column;
+    ctx.grid[r][c] = ctx.originalGrid[r][c];
+    ctx.safetyDelay[r][c] = 0;
+    refreshTileInfo(ctx, r, c);
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Write the payload.
+// ----------------------------------------------------------------------------
+static void writePayload(const SimulationContext &ctx, vector<int32_t> &out) {
+    out.push_back(ctx.currentTick);
+    out.push_back(ctx.totalTicks);
+    out.push_back(ctx.simulationRunning);
+    out.push_back(ctx.levelSeed);
+    out.push_back(ctx.weather_type);
+    out.push_back((int32_t)ctx.rngState);
+    out.push_back(ctx.trainsReached);
+    out.push_back(ctx.crashed_trains);
+    out.push_back(ctx.totalWaitTicks);
+    out.push_back(ctx.T_energy);
+    out.push_back(ctx.switchFlips);
+    out.push_back(ctx.signalViolations);
+
+    // Trains (slots past numOf_trains have never been used)
+    out.push_back(ctx.numOf_trains);
+    for (int i = 0; i < ctx.numOf_trains; i++) {
+        out.push_back(ctx.trainRow[i]);
+        out.push_back(ctx.trainColumn[i]);
+        out.push_back(ctx.trainDirection[i]);
+        out.push_back(ctx.trainColor[i]);
+        out.push_back(ctx.trainWait[i]);
+    }
+    for (int i = 0; i < ctx.trainCapacity; i++) out.push_back(ctx.trainDestination[i]);
+
+    // Spawns and destinations (ticks too: the optimizer changes them)
+    for (int i = 0; i < ctx.num_spawn; i++) {
+        out.push_back(ctx.spawnTick[i]);
+        out.push_back(ctx.spawnTrainID[i]);
+    }
+    for (int d = 0; d < ctx.numDest; d++) out.push_back(ctx.destinationTrainID[d]);
+
+    // Switches and their pending work
+    for (int i = 0; i < ctx.numSwitches; i++) {
+        out.push_back(ctx.switchState[i]);
+        out.push_back(ctx.switchMode[i]);
+        out.push_back(ctx.switchFlipped[i]);
+        out.push_back(ctx.switchSignal[i]);
+        for (int k = 0; k < 4; k++) out.push_back(ctx.switchK[i][k]);
+        for (int k = 0; k < 4; k++) out.push_back(ctx.switchCounter[i][k]);
+    }
+    out.push_back(ctx.numSwitchEntries);
+    for (int e = 0; e < ctx.numSwitchEntries; e++) out.push_back(ctx.switchEntries[e]);
+    out.push_back(ctx.numDueCounters);
+    for (int d = 0; d < ctx.numDueCounters; d++) out.push_back(ctx.dueCounters[d]);
+    out.push_back(ctx.numQueuedFlips);
+    for (int q = 0; q < ctx.numQueuedFlips; q++) out.push_back(ctx.flipQueue[q]);
+
+    // Emergency halts: the zones, then every tile still halted
+    out.push_back(ctx.emergencyHaltActive);
+    out.push_back(ctx.numHaltZones);
+    for (int z = 0; z < ctx.numHaltZones; z++) {
+        out.push_back(ctx.haltZoneRow[z]);
+        out.push_back(ctx.haltZoneColumn[z]);
+        out.push_back(ctx.haltZoneExpiry[z]);
+    }
+    int cells = ctx.number_rows * ctx.number_column;
+    size_t countAt = out.size();
+    out.push_back(0);
+    for (int cell = 0; cell < cells; cell++) {
+        int end = ctx.emergencyHalt[cell / ctx.number_column][cell % ctx.number_column];
+        if (end <= ctx.currentTick) continue;   // Over; never read again
+        out.push_back(cell);
+        out.push_back(end);
+        out[countAt]++;
+    }
+
+    // Edited tiles, in cell order
+    countAt = out.size();
+    out.push_back(0);
+    for (int cell = 0; cell < cells; cell++) {
+        if (!tileEdited(ctx, cell)) continue;
+        int r = cell / ctx.number_column, c = cell % ctx.number_column;
+        out.push_back(cell);
+        out.push_back((unsigned char)ctx.grid[r][c]);
+        out.push_back(ctx.safetyDelay[r][c]);
+        out[countAt]++;
+    }
+}
+
+void takeSnapshot(const SimulationContext &ctx, vector<char> &snapshot) {
+    vector<int32_t> payload;
+    payload.reserve(64 + (size_t)ctx.numOf_trains * 5 + ctx.trainCapacity + ctx.num_spawn * 2);
+    writePayload(ctx, payload);
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+    header.version         = snapshot_version;
+    header.payloadValues   = (uint32_t)payload.size();
+    header.levelHash       = ctx.levelHash;
+    header.rows            = ctx.number_rows;
+    header.columns         = ctx.number_column;
+    header.trainCapacity   = ctx.trainCapacity;
+    header.numSwitches     = ctx.numSwitches;
+    header.numSpawns       = ctx.num_spawn;
+    header.numDestinations = ctx.numDest;
+
+    size_t payloadBytes = payload.size() * sizeof(int32_t);
+    snapshot.resize(sizeof(header) + payloadBytes);
+    memcpy(&snapshot[sizeof(header)], &payload[0], payloadBytes);
+    header.checksum = checksumBytes(&snapshot[sizeof(header)], payloadBytes);
+    memcpy(&snapshot[0], &header, sizeof(header));
+}
+
+// ----------------------------------------------------------------------------
+// Read the payload.
+// ----------------------------------------------------------------------------
+// Runs twice: first with apply=false to check every value against the
+// level, then with apply=true to write them, so a bad snapshot changes
+// nothing.
+// ----------------------------------------------------------------------------
+struct SnapshotReader {
+    const char *at;
+    const char *end;
+    bool ok;
+
+    // Next value, which must lie in [low, high]
+    int next(int low, int high) {
+        if (at + sizeof(int32_t) > end) {
+            ok = false;
+            return low;
+        }
+        int32_t value;
+        memcpy(&value, at, sizeof(value));
+        at += sizeof(value);
+        if (value < low || value > high) {
+            ok = false;
+            return low;
+        }
+        return value;
+    }
+};
+
+static const int any_value = 0x7FFFFFFF;
+
+static bool readPayload(SimulationContext &ctx, SnapshotReader in, bool apply, bool &tilesChange) {
+    int cells = ctx.number_rows * ctx.number_column;
+    int trains = ctx.trainCapacity;
+
+    int scalars[12];
+    for (int s = 0; s < 12; s++) scalars[s] = in.next(-any_value, any_value);
+    int numTrains = in.next(0, trains);
+    if (apply) {
+        ctx.currentTick      = scalars[0];
+        ctx.totalTicks       = scalars[1];
+        ctx.simulationRunning= scalars[2];
+        ctx.levelSeed        = scalars[3];
+        ctx.weather_type     = scalars[4];
+        ctx.rngState         = (unsigned int)scalars[5];
+        ctx.trainsReached    = scalars[6];
+        ctx.crashed_trains   = scalars[7];
+        ctx.totalWaitTicks   = scalars[8];
+        ctx.T_energy         = scalars[9];
+        ctx.switchFlips      = scalars[10];
+        ctx.signalViolations = scalars[11];
+    } else if (scalars[4] < 0 || scalars[4] >= weather_types) {
+        return false;
+    }
+
+    for (int i = 0; i < numTrains; i++) {
+        int row = in.next(-1, ctx.number_rows - 1);
+        int col = in.next(-1, ctx.number_column - 1);
+        int dir = in.next(0, 3);
+        int color = in.next(-any_value, any_value);
+        int wait = in.next(0, any_value);
+        if (!apply) continue;
+        ctx.trainRow[i] = row;
+        ctx.trainColumn[i] = col;
+        ctx.trainDirection[i] = dir;
+        ctx.trainColor[i] = color;
+        ctx.trainWait[i] = wait;
+    }
+    if (apply) {
+        // Slots the snapshot never used go back to their defaults
+        for (int i = numTrains; i < ctx.numOf_trains; i++) {
+            ctx.trainRow[i] = -1;
+            ctx.trainColumn[i] = -1;
+            ctx.trainDirection[i] = train_right;
+            ctx.trainColor[i] = 0;
+            ctx.trainWait[i] = 0;
+        }
+        ctx.numOf_trains = numTrains;
+    }
+    for (int i = 0; i < trains; i++) {
+        int d = in.next(-1, ctx.numDest - 1);
+        if (apply) ctx.trainDestination[i] = d;
+    }
+
+    for (int i = 0; i < ctx.num_spawn; i++) {
+        int tick = in.next(-any_value, any_value);
+        int id = in.next(-1, trains - 1);
+        if (!apply) continue;
+        ctx.spawnTick[i] = tick;
+        ctx.spawnTrainID[i] = id;
+    }
+    for (int d = 0; d < ctx.numDest; d++) {
+        int id = in.next(-1, trains - 1);
+        if (apply) ctx.destinationTrainID[d] = id;
+    }
+
+    for (int i = 0; i < ctx.numSwitches; i++) {
+        int state = in.next(0, 1);
+        int mode = in.next(0, 1);
+        int flipped = in.next(0, 1);
+        int signal = in.next(0, max_signals - 1);
+        int k[4], counter[4];
+        for (int d = 0; d < 4; d++) k[d] = in.next(-any_value, any_value);
+        for (int d = 0; d < 4; d++) counter[d] = in.next(-any_value, any_value);
+        if (!apply) continue;
+        ctx.switchState[i] = state;
+        ctx.switchMode[i] = mode;
+        ctx.switchFlipped[i] = flipped;
+        ctx.switchSignal[i] = signal;
+        for (int d = 0; d < 4; d++) {
+            ctx.switchK[i][d] = k[d];
+            ctx.switchCounter[i][d] = counter[d];
+        }
+    }
+    int entries = in.next(0, trains);
+    for (int e = 0; e < entries; e++) {
+        int id = in.next(0, trains - 1);
+        if (apply) ctx.switchEntries[e] = id;
+    }
+    int due = in.next(0, ctx.numSwitches * 4);
+    for (int d = 0; d < due; d++) {
+        int counter = in.next(0, ctx.numSwitches * 4 - 1);
+        if (apply) ctx.dueCounters[d] = counter;
+    }
+    int queued = in.next(0, ctx.numSwitches);
+    for (int q = 0; q < queued; q++) {
+        int id = in.next(0, ctx.numSwitches - 1);
+        if (apply) ctx.flipQueue[q] = id;
+    }
+    if (apply) {
+        ctx.numSwitchEntries = entries;
+        ctx.numDueCounters = due;
+        ctx.numQueuedFlips = queued;
+    }
+
+    int haltActive = in.next(0, 1);
+    int zones = in.next(0, max_halt_zones);
+    for (int z = 0; z < zones; z++) {
+        int row = in.next(0, ctx.number_rows - 1);
+        int col = in.next(0, ctx.number_column - 1);
+        int expiry = in.next(-any_value, any_value);
+        if (!apply) continue;
+        ctx.haltZoneRow[z] = row;
+        ctx.haltZoneColumn[z] = col;
+        ctx.haltZoneExpiry[z] = expiry;
+    }
+    if (apply) {
+        ctx.emergencyHaltActive = haltActive;
+        ctx.numHaltZones = zones;
+        if (cells > 0) memset(ctx.emergencyHalt[0], 0, (size_t)cells * sizeof(int));
+    }
+    int halted = in.next(0, cells);
+    for (int h = 0; h < halted; h++) {
+        int cell = in.next(0, cells - 1);
+        int end = in.next(-any_value, any_value);
+        if (apply) ctx.emergencyHalt[cell / ctx.number_column][cell % ctx.number_column] = end;
+    }
+
+    // Edited tiles. The list ascends, so one sweep applies it and undoes
+    // the context's other edits; the first pass only notes whether any
+    // tile changes.
+    int edits = in.next(0, cells);
+    int scan = 0;
+    tilesChange = false;
+    for (int e = 0; e < edits && in.ok; e++) {
+        int cell = in.next(scan, cells - 1);
+        char tile = (char)in.next(1, 127);
+        int delay = in.next(-any_value, any_value);
+        if (!in.ok) break;
+        for (; scan < cell; scan++) tilesChange |= apply ? revertTile(ctx, scan) : tileEdited(ctx, scan);
+        int r = cell / ctx.number_column, c = cell % ctx.number_column;
+        if (ctx.grid[r][c] != tile || ctx.safetyDelay[r][c] != delay) {
+            tilesChange = true;
+            if (apply) {
+                ctx.grid[r][c] = tile;
+                ctx.safetyDelay[r][c] = delay;
+                refreshTileInfo(ctx, r, c);
+            }
+        }
+        scan = cell + 1;
+    }
+    if (!in.ok || in.at != in.end) return false;
+    for (; scan < cells; scan++) tilesChange |= apply ? revertTile(ctx, scan) : tileEdited(ctx, scan);
+    return true;
+}
+
+bool restoreSnapshot(SimulationContext &ctx, const char *snapshot, size_t bytes) {
+    SnapshotHeader header;
+    if (!snapshot || bytes < sizeof(header)) return false;
+    memcpy(&header, snapshot, sizeof(header));
+    if (memcmp(header.magic, snapshot_magic, sizeof(header.magic)) != 0) return false;
+    if (header.version != snapshot_version) return false;
+    if (header.levelHash != ctx.levelHash) return false;
+    if (header.rows != ctx.number_rows || header.columns != ctx.number_column ||
+        header.trainCapacity != ctx.trainCapacity || header.numSwitches != ctx.numSwitches ||
+        header.numSpawns != ctx.num_spawn || header.numDestinations != ctx.numDest) {
+        return false;
+    }
+    size_t payloadBytes = bytes - sizeof(header);
+    if (payloadBytes != (size_t)header.payloadValues * sizeof(int32_t)) return false;
+    const char *payload = snapshot + sizeof(header);
+    if (checksumBytes(payload, payloadBytes) != header.checksum) return false;
+
+    SnapshotReader in;
+    in.at = payload;
+    in.end = payload + payloadBytes;
+    in.ok = true;
+    bool tilesChange;
+    if (!readPayload(ctx, in, false, tilesChange)) return false;
+
+    // Map edits follow toggleSafetyTile: a fork copies the level it shares
+    // first, and a level that forks are reading cannot change
+    bool routed = ctx.routeField || ctx.routePlanner;
+    bool graphed = ctx.trackGraph != 0;
+    if (tilesChange && (ctx.levelForks > 0 || !detachLevel(ctx))) return false;
+    readPayload(ctx, in, true, tilesChange);
+    if (tilesChange) {
+        if (routed) buildRouteField(ctx);
+        if (graphed) buildTrackGraph(ctx);
+    }
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Snapshot files
+// ----------------------------------------------------------------------------
+bool writeSnapshotFile(const vector<char> &snapshot, const string &path) {
+    string temporary = path + ".tmp" + to_string((long long)getpid());
+    FILE *file = fopen(temporary.c_str(), "wb");
+    if (!file) return false;
+    bool ok = fwrite(&snapshot[0], 1, snapshot.size(), file) == snapshot.size();
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(temporary.c_str(), path.c_str()) != 0) {
+        unlink(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool readSnapshotFile(const string &path, vector<char> &snapshot) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+    snapshot.clear();
+    char buffer[1 << 14];
+    size_t got;
+    while ((got = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        snapshot.insert(snapshot.end(), buffer, buffer + got);
+    }
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
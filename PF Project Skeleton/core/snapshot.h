@@ -0,0 +1,36 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// ============================================================================
+// SNAPSHOT.H - Simulation snapshots
+// ============================================================================
+// A snapshot is everything a run changes after its level is loaded: trains,
+// spawn and destination bookkeeping, switches and their pending work,
+// metrics, live emergency halts, edited tiles and the random stream. Level
+// data (map, tile records, routing) is not stored; a snapshot is restored
+// into a context holding the same level, which it checks by hash and sizes.
+// Take snapshots between ticks.
+// ============================================================================
+
+struct SimulationContext;
+
+// Capture ctx into `snapshot` (replacing its contents).
+void takeSnapshot(const SimulationContext &ctx, std::vector<char> &snapshot);
+
+// Restore a snapshot into ctx. Returns false, leaving ctx untouched, if the
+// snapshot is damaged, from another format version, or of another level, or
+// if it would edit the map of a context that forks are reading.
+bool restoreSnapshot(SimulationContext &ctx, const char *snapshot, size_t bytes);
+
+// Write a snapshot to `path` (under a temporary name first, so a crash never
+// leaves half a file). Returns false on I/O errors.
+bool writeSnapshotFile(const std::vector<char> &snapshot, const std::string &path);
+
+// Read a snapshot file written by writeSnapshotFile.
+bool readSnapshotFile(const std::string &path, std::vector<char> &snapshot);
+
+#endif
@@ -0,0 +1,116 @@
+#include "sweep.h"
+#include "simulation_state.h"
+#include "simulation.h"
+#include "level_cache.h"
+#include "work_stealing.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+using namespace std;
+
+// ============================================================================
+// SWEEP.CPP - Monte Carlo runs over seeds and weather
+// ============================================================================
+
+void planSweep(unsigned int firstSeed, unsigned int lastSeed,
+               const vector<int> &weathers, vector<SweepRun> &runs) {
+    for (size_t w = 0; w < weathers.size(); w++) {
+        for (unsigned int seed = firstSeed; ; seed++) {
+            SweepRun run;
+            run.seed    = seed;
+            run.weather = weathers[w];
+            runs.push_back(run);
+            if (seed == lastSeed) break;
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// One run: a copy of the shared compiled level with the run's seed and
+// weather, stepped event to event (same result as tick by tick) until the
+// simulation completes.
+// ----------------------------------------------------------------------------
+static void simulateRun(SimulationContext &ctx, const vector<char> &image, SweepRun &run) {
+    initializeSimulation(ctx);
+    loadCompiledImage(ctx, &image[0], image.size(), 0);
+
+    ctx.levelSeed    = run.seed;
+    ctx.weather_type = run.weather;
+    seedRandom(ctx, run.seed);
+
+    while (true) {
+        advanceUntilNextEvent(ctx);
+        if (isSimulationComplete(ctx)) break;
+    }
+
+    run.delivered      = ctx.trainsReached;
+    run.crashed        = ctx.crashed_trains;
+    run.waitTicks      = ctx.totalWaitTicks;
+    run.completionTick = ctx.currentTick;
+    run.finished       = true;
+}
+
+size_t runSweep(const string &level, vector<SweepRun> &runs, int threads,
+                LevelLoadError *error) {
+    // Parse once; every run copies the compiled image instead
+    vector<char> image;
+    {
+        SimulationContext ctx;
+        initializeSimulation(ctx);
+        LevelLoadError loadError;
+        if (!loadLevelFile(ctx, level, &loadError)) {
+            if (error) *error = loadError;
+            return 0;
+        }
+        if (!compileLevel(ctx, image)) {
+            if (error) {
+                error->file = level;
+                error->line = 0;
+                error->message = "Could not compile level";
+            }
+            return 0;
+        }
+    }
+
+    threads = workStealingThreads(runs.size(), threads);
+    vector<unique_ptr<SimulationContext> > contexts(threads);
+    for (int t = 0; t < threads; t++) contexts[t].reset(new SimulationContext());
+
+    runWorkStealing(runs.size(), threads, [&](size_t index, int worker) {
+        simulateRun(*contexts[worker], image, runs[index]);
+    });
+
+    size_t finished = 0;
+    for (size_t i = 0; i < runs.size(); i++) {
+        if (runs[i].finished) finished++;
+    }
+    return finished;
+}
+
+SweepDistribution summarizeSweep(vector<int> values) {
+    SweepDistribution d;
+    d.count = values.size();
+    d.mean = d.stddev = 0.0;
+    d.min = d.p50 = d.p90 = d.p99 = d.max = 0;
+    if (values.empty()) return d;
+
+    sort(values.begin(), values.end());
+    double sum = 0.0;
+    for (size_t i = 0; i < values.size(); i++) sum += values[i];
+    d.mean = sum / values.size();
+    double squares = 0.0;
+    for (size_t i = 0; i < values.size(); i++) {
+        squares += (values[i] - d.mean) * (values[i] - d.mean);
+    }
+    d.stddev = sqrt(squares / values.size());
+
+    // Nearest rank: the smallest value with at least p% of runs at or below it
+    size_t n = values.size();
+    d.min = values[0];
+    d.p50 = values[(n * 50 + 99) / 100 - 1];
+    d.p90 = values[(n * 90 + 99) / 100 - 1];
+    d.p99 = values[(n * 99 + 99) / 100 - 1];
+    d.max = values[n - 1];
+    return d;
+}
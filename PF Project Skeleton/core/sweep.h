@@ -0,0 +1,54 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include "io.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// ============================================================================
+// SWEEP.H - Monte Carlo runs over seeds and weather
+// ============================================================================
+// Runs one level many times, each run with its own random seed and weather,
+// on every core, and summarizes the metrics.txt figures of all runs.
+// ============================================================================
+
+struct SweepRun {
+    unsigned int seed;
+    int weather;
+    bool finished;          // False if the level failed to load
+    int delivered;
+    int crashed;
+    int waitTicks;
+    int completionTick;
+
+    SweepRun() : seed(0), weather(0), finished(false), delivered(0), crashed(0),
+                 waitTicks(0), completionTick(0) {}
+};
+
+// Spread of one metric over a set of runs.
+struct SweepDistribution {
+    size_t count;
+    double mean;
+    double stddev;
+    int min, p50, p90, p99, max;
+};
+
+// Append one run for every seed in [firstSeed, lastSeed] under every weather
+// in `weathers` (weather-major order).
+void planSweep(unsigned int firstSeed, unsigned int lastSeed,
+               const std::vector<int> &weathers, std::vector<SweepRun> &runs);
+
+// Simulate every run in `runs` on `level` to completion using `threads`
+// workers (0 = one per hardware thread). Runs are spread with the
+// work-stealing runner. The level is parsed once and compiled; each run loads
+// that read-only image into its worker's context and applies its seed and
+// weather. Returns the number of finished runs; if the level fails to load,
+// `error` gets the reason.
+size_t runSweep(const std::string &level, std::vector<SweepRun> &runs, int threads,
+                LevelLoadError *error);
+
+// Summarize values (nearest-rank percentiles; all zero when empty).
+SweepDistribution summarizeSweep(std::vector<int> values);
+
+#endif
@@ -13,58 +13,51 @@ using namespace std;
 // ----------------------------------------------------------------------------
 // UPDATE SWITCH COUNTERS
 // ----------------------------------------------------------------------------
-// Increment counters for trains entering switches.
-// ----------------------------------------------------------------------------
-void updateSwitchCounters() {
-    // Loop through all active trains
-    for (int i = 0; i < numOf_trains; i++) {
-        // Skip if train is not on the map
-        if (trainRow[i] == -1) continue;
+// Increment counters for trains that entered switches on the last move
+// (recorded by moveAllTrains). Counters that reach K are marked due.
+// ----------------------------------------------------------------------------
+void updateSwitchCounters(SimulationContext &ctx) {
+    for (int e = 0; e < ctx.numSwitchEntries; e++) {
+        int i = ctx.switchEntries[e];
+        // Skip if train has left the map since it entered
+        if (ctx.trainRow[i] == -1) continue;
 
-        // Get the tile the train is currently standing on
-        char tile = grid[trainRow[i]][trainColumn[i]];
+        int swID = ctx.tileInfo[ctx.trainRow[i] * ctx.number_column + ctx.trainColumn[i]].switchIndex;
+        if (swID < 0 || swID >= ctx.numSwitches) continue;
 
-        // Check if the tile is a switch (A-Z)
-        if (tile >= 'A' && tile <= 'Z') {
-            int swID = tile - 'A'; // Convert 'A'->0, 'B'->1, etc.
-            int dir = trainDirection[i];
+        // Global mode uses the 0-index counter, Per-Direction mode the
+        // counter for this train's direction
+        int dir = (ctx.switchMode[swID] == GLOBAL) ? 0 : ctx.trainDirection[i];
 
-            // Update counter based on the switch mode
-            if (switchMode[swID] == GLOBAL) {
-                // Global mode: increment the 0-index counter
-                switchCounter[swID][0]++;
-            } else {
-                // Per-Direction mode: increment the counter for this specific direction
-                switchCounter[swID][dir]++;
-            }
+        // A K of 0 or less flips on every entry
+        int limit = ctx.switchK[swID][dir] > 0 ? ctx.switchK[swID][dir] : 1;
+        if (++ctx.switchCounter[swID][dir] == limit) {
+            ctx.dueCounters[ctx.numDueCounters++] = swID * 4 + dir;
         }
     }
+    ctx.numSwitchEntries = 0;
 }
 
 // ----------------------------------------------------------------------------
 // QUEUE SWITCH FLIPS
 // ----------------------------------------------------------------------------
-// Queue flips when counters hit K.
+// Queue flips for counters that hit K.
 // ----------------------------------------------------------------------------
-void queueSwitchFlips() {
-    for (int i = 0; i < numSwitches; i++) {
-        // Check all 4 directions (Up, Right, Down, Left)
-        for (int dir = 0; dir < 4; dir++) {
-            
-            // If Global mode, we only care about index 0
-            if (switchMode[i] == GLOBAL && dir > 0) continue;
+void queueSwitchFlips(SimulationContext &ctx) {
+    for (int d = 0; d < ctx.numDueCounters; d++) {
+        int i   = ctx.dueCounters[d] / 4;
+        int dir = ctx.dueCounters[d] % 4;
 
-            // If counter has reached the K-value limit
-            if (switchCounter[i][dir] >= switchK[i][dir]) {
-                
-                // Mark the switch to flip later (Deferred Flip)
-                switchFlipped[i] = 1;
-                
-                // Reset the counter immediately so it can start counting again
-                switchCounter[i][dir] = 0;
-            }
+        // Mark the switch to flip later (Deferred Flip)
+        if (ctx.switchFlipped[i] == 0) {
+            ctx.switchFlipped[i] = 1;
+            ctx.flipQueue[ctx.numQueuedFlips++] = i;
         }
+
+        // Reset the counter immediately so it can start counting again
+        ctx.switchCounter[i][dir] = 0;
     }
+    ctx.numDueCounters = 0;
 }
 
 // ----------------------------------------------------------------------------
@@ -72,18 +65,18 @@ void queueSwitchFlips() {
 // ----------------------------------------------------------------------------
 // Apply queued flips after movement.
 // ----------------------------------------------------------------------------
-void applyDeferredFlips() {
-    for (int i = 0; i < numSwitches; i++) {
-        // If the switch was marked to flip in the queue step
-        if (switchFlipped[i] == 1) {
-            
-            // Toggle state: 0 becomes 1, 1 becomes 0
-            switchState[i] = !switchState[i];
-            
-            // Reset the flip flag
-            switchFlipped[i] = 0;
-        }
+void applyDeferredFlips(SimulationContext &ctx) {
+    for (int q = 0; q < ctx.numQueuedFlips; q++) {
+        int i = ctx.flipQueue[q];
+
+        // Toggle state: 0 becomes 1, 1 becomes 0
+        ctx.switchState[i] = !ctx.switchState[i];
+        ctx.switchFlips++;
+
+        // Reset the flip flag
+        ctx.switchFlipped[i] = 0;
     }
+    ctx.numQueuedFlips = 0;
 }
 
 // ----------------------------------------------------------------------------
@@ -91,11 +84,11 @@ void applyDeferredFlips() {
 // ----------------------------------------------------------------------------
 // Update signal colors for switches.
 // ----------------------------------------------------------------------------
-void updateSignalLights() {
-    for (int i = 0; i < numSwitches; i++) {
+void updateSignalLights(SimulationContext &ctx) {
+    for (int i = 0; i < ctx.numSwitches; i++) {
         // Basic Logic: Set all signals to GREEN (0) for now.
         // (Advanced logic requires checking track occupancy ahead)
-        switchSignal[i] = 0; 
+        ctx.switchSignal[i] = 0; 
     }
 }
 
@@ -104,10 +97,10 @@ void updateSignalLights() {
 // ----------------------------------------------------------------------------
 // Manually toggle a switch state.
 // ----------------------------------------------------------------------------
-void toggleSwitchState(int switchID) {
+void toggleSwitchState(SimulationContext &ctx, int switchID) {
     // Check bounds to be safe
-    if (switchID >= 0 && switchID < numSwitches) {
-        switchState[switchID] = !switchState[switchID];
+    if (switchID >= 0 && switchID < ctx.numSwitches) {
+        ctx.switchState[switchID] = !ctx.switchState[switchID];
     }
 }
 
@@ -116,10 +109,10 @@ void toggleSwitchState(int switchID) {
 // ----------------------------------------------------------------------------
 // Return the state for a given direction.
 // ----------------------------------------------------------------------------
-int getSwitchStateForDirection(int switchID, int direction) {
+int getSwitchStateForDirection(const SimulationContext &ctx, int switchID, int direction) {
     // Check bounds
-    if (switchID >= 0 && switchID < numSwitches) {
-        return switchState[switchID];
+    if (switchID >= 0 && switchID < ctx.numSwitches) {
+        return ctx.switchState[switchID];
     }
     return 0; // Default to straight if invalid ID
 }
\ No newline at end of file
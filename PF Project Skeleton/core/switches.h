@@ -5,40 +5,42 @@
 // SWITCHES.H - Switch logic
 // ============================================================================
 
+struct SimulationContext;
+
 // ----------------------------------------------------------------------------
 // SWITCH COUNTER UPDATE
 // ----------------------------------------------------------------------------
 // Increment counters when trains enter switches.
-void updateSwitchCounters();
+void updateSwitchCounters(SimulationContext &ctx);
 
 // ----------------------------------------------------------------------------
 // FLIP QUEUE
 // ----------------------------------------------------------------------------
 // Queue flips when counters reach K.
-void queueSwitchFlips();
+void queueSwitchFlips(SimulationContext &ctx);
 
 // ----------------------------------------------------------------------------
 // DEFERRED FLIP
 // ----------------------------------------------------------------------------
 // Apply queued flips after movement.
-void applyDeferredFlips();
+void applyDeferredFlips(SimulationContext &ctx);
 
 // ----------------------------------------------------------------------------
 // SIGNAL CALCULATION
 // ----------------------------------------------------------------------------
 // Update switch signal colors.
-void updateSignalLights();
+void updateSignalLights(SimulationContext &ctx);
 
 // ----------------------------------------------------------------------------
 // SWITCH TOGGLE (for manual control / editing)
 // ----------------------------------------------------------------------------
 // Manually toggle a switch state.
-void toggleSwitchState(int switchID);
+void toggleSwitchState(SimulationContext &ctx, int switchID);
 
 // ----------------------------------------------------------------------------
 // HELPER FUNCTIONS
 // ----------------------------------------------------------------------------
 // Get state for a given direction.
-int getSwitchStateForDirection(int switchID, int direction);
+int getSwitchStateForDirection(const SimulationContext &ctx, int switchID, int direction);
 
 #endif
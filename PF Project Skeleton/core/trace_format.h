@@ -0,0 +1,97 @@
+#ifndef TRACE_FORMAT_H
+#define TRACE_FORMAT_H
+
+#include "simulation_state.h"
+#include <cstddef>
+#include <cstdint>
+
+// ============================================================================
+// TRACE_FORMAT.H - Binary trace layout
+// ============================================================================
+// Binary alternative to trace.csv, switches.csv and signals.csv (one .bin
+// file per table). A file is a TraceHeader followed by chunks of
+// trace_chunk_rows rows; only the last chunk may be shorter. Inside a chunk
+// the table is stored column by column, each column a packed array of
+// fixed-width integers in host byte order. Chunk and column offsets follow
+// from the header alone, so a reader can mmap the file and index it
+// directly (see tools/trace_to_csv.cpp).
+//
+// Switch and signal tables may be delta tables (keyframeTicks > 0): a switch
+// only has a row on ticks where it changed, plus every switch on keyframe
+// ticks (the first logged tick, then at least keyframeTicks apart). Carrying
+// each switch's last row forward rebuilds the full table.
+// ============================================================================
+
+const char trace_magic[8]={'S','B','T','R','A','C','E','\0'};
+const uint32_t trace_version=1;
+const uint32_t trace_chunk_rows=4096;
+const int trace_max_columns=8;
+
+//Tables
+const uint32_t trace_table_trains=0;      //trace.csv
+const uint32_t trace_table_switches=1;    //switches.csv
+const uint32_t trace_table_signals=2;     //signals.csv
+const int trace_tables=3;
+
+struct TraceHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t table;
+    uint64_t levelHash;                   //FNV-1a of the level file
+    int32_t seed;                         //Level SEED
+    int32_t firstTick;                    //Ticks logged; -1 when none
+    int32_t lastTick;
+    uint32_t chunkRows;
+    uint64_t rows;
+    uint32_t columns;
+    uint32_t columnWidth[trace_max_columns];  //Bytes per value
+    uint32_t keyframeTicks;               //Delta table: ticks between keyframes (0 = full)
+    uint32_t reserved[2];
+};
+static_assert(sizeof(TraceHeader)==96,"TraceHeader layout changed");
+
+// ----------------------------------------------------------------------------
+// Column layout of each table (widths in bytes, matching the CSV columns).
+// ----------------------------------------------------------------------------
+//trains:   tick, train, x (column), y (row), direction, state (wait)
+//switches: tick, letter, mode, state
+//signals:  tick, letter, signal
+const int trace_table_columns[trace_tables]={6,4,3};
+const uint32_t trace_column_widths[trace_tables][trace_max_columns]={
+    {4,4,2,2,1,2,0,0},
+    {4,1,1,1,0,0,0,0},
+    {4,1,1,0,0,0,0,0},
+};
+
+//CSV header line of each table
+const char *const trace_csv_headers[trace_tables]={
+    "time_Tick,Id_train,X_cord,Y_cord,Direction,State\n",
+    "time_Tick,Switch,mode,State\n",
+    "time_Tick,Switch,Signal\n",
+};
+
+// Bytes in one row of a table
+inline size_t traceRowBytes(const TraceHeader &header) {
+    size_t bytes=0;
+    for(uint32_t c=0;c<header.columns;c++) bytes+=header.columnWidth[c];
+    return bytes;
+}
+
+// Offset of column `column` of chunk `chunk`, from the start of the file
+inline size_t traceColumnOffset(const TraceHeader &header,uint64_t chunk,uint32_t column) {
+    uint64_t chunkStart=chunk*header.chunkRows;
+    uint64_t rows=header.rows-chunkStart;
+    if(rows>header.chunkRows) rows=header.chunkRows;
+    size_t offset=sizeof(TraceHeader)+(size_t)(chunkStart*traceRowBytes(header));
+    for(uint32_t c=0;c<column;c++) offset+=(size_t)(rows*header.columnWidth[c]);
+    return offset;
+}
+
+// Signal name as written in signals.csv
+inline const char *traceSignalName(int signal) {
+    if(signal==signal_yellow) return "YELLOW";
+    if(signal==sigal_red) return "RED";
+    return "GREEN";                       //signal_green, and the default
+}
+
+#endif
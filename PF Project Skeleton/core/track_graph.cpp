@@ -0,0 +1,132 @@
+#include "track_graph.h"
+#include "routing.h"
+#include "grid.h"
+
+using namespace std;
+
+// ============================================================================
+// TRACK_GRAPH.CPP - Compressed track graph
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// Directions a train standing on a tile may leave it by this tick.
+// ----------------------------------------------------------------------------
+// Follows the turn table; switches and crossings may use any track neighbour.
+// Trains on a destination point skip routing and keep whatever heading they
+// have, so those tiles may also leave in any direction. Empty and scenery
+// tiles hold no trains.
+// ----------------------------------------------------------------------------
+static unsigned char exitMask(const TileInfo &info) {
+    if (info.pointMask & point_destination) return info.trackMask;
+    // Nothing stands on scenery, except a train spawned there
+    if (info.tileClass == tile_empty || info.tileClass == tile_other) {
+        return (info.pointMask & point_spawn) ? info.trackMask : 0;
+    }
+    unsigned char mask = 0;
+    for (int dir = 0; dir < 4; dir++) {
+        int turn = turnTable[info.routeClass][dir];
+        if (turn == route_dynamic) return info.trackMask;
+        mask |= (unsigned char)(1 << turn);
+    }
+    return mask & info.trackMask;
+}
+
+// ----------------------------------------------------------------------------
+// Axis of a run tile: 1 = horizontal, 2 = vertical, 0 = node or no track.
+// ----------------------------------------------------------------------------
+// A run tile is straight track (a '=' counts as the track it covers) that is
+// neither a spawn nor a destination and cannot be entered from the side.
+// ----------------------------------------------------------------------------
+static int runAxis(const SimulationContext &ctx, int row, int col) {
+    const TileInfo &info = ctx.tileInfo[row * ctx.number_column + col];
+    if (info.pointMask != 0) return 0;
+    if (info.tileClass != tile_horizontal && info.tileClass != tile_vertical &&
+        info.tileClass != tile_safety) return 0;
+
+    int axis;
+    if (info.routeClass == tile_horizontal) axis = 1;
+    else if (info.routeClass == tile_vertical) axis = 2;
+    else return 0;
+
+    // Sides: up/down of a horizontal run, left/right of a vertical one
+    int firstSide = (axis == 1) ? up_dir : right_dir;
+    for (int side = firstSide; side < 4; side += 2) {
+        int r = row + row_change[side];
+        int c = col + column_change[side];
+        if (!isInBounds(ctx, r, c)) continue;
+        int towardUs = (side + 2) % 4;
+        if ((exitMask(ctx.tileInfo[r * ctx.number_column + c]) >> towardUs) & 1) return 0;
+    }
+    return axis;
+}
+
+// Track cell one step past an end of a run, or -1
+static int endNodeAt(const SimulationContext &ctx, int row, int col) {
+    if (!isInBounds(ctx, row, col)) return -1;
+    unsigned char tileClass = ctx.tileInfo[row * ctx.number_column + col].tileClass;
+    if (tileClass == tile_empty || tileClass == tile_other) return -1;
+    return row * ctx.number_column + col;
+}
+
+// ----------------------------------------------------------------------------
+// Build the graph.
+// ----------------------------------------------------------------------------
+// Marks every run tile with its axis, then collects maximal runs row by row
+// (horizontal) and column by column (vertical).
+// ----------------------------------------------------------------------------
+bool buildTrackGraph(SimulationContext &ctx) {
+    releaseTrackGraph(ctx);
+    TrackGraph *graph = new TrackGraph();
+    int rows = ctx.number_rows;
+    int cols = ctx.number_column;
+    size_t cells = (size_t)rows * cols;
+    for (size_t c = 0; c < cells; c++) ctx.tileInfo[c].segment = -1;
+
+    vector<unsigned char> axis(cells);
+    for (int r = 0; r < rows; r++)
+        for (int c = 0; c < cols; c++)
+            axis[(size_t)r * cols + c] = (unsigned char)runAxis(ctx, r, c);
+
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < cols; c++) {
+            if (axis[(size_t)r * cols + c] != 1) continue;
+            int start = c;
+            while (c + 1 < cols && axis[(size_t)r * cols + c + 1] == 1) c++;
+            TrackSegment run;
+            run.firstCell  = r * cols + start;
+            run.lastCell   = r * cols + c;
+            run.step       = 1;
+            run.endNode[0] = endNodeAt(ctx, r, start - 1);
+            run.endNode[1] = endNodeAt(ctx, r, c + 1);
+            for (int cell = run.firstCell; cell <= run.lastCell; cell++) {
+                ctx.tileInfo[cell].segment = (int)graph->segments.size();
+            }
+            graph->segments.push_back(run);
+        }
+    }
+    for (int c = 0; c < cols; c++) {
+        for (int r = 0; r < rows; r++) {
+            if (axis[(size_t)r * cols + c] != 2) continue;
+            int start = r;
+            while (r + 1 < rows && axis[(size_t)(r + 1) * cols + c] == 2) r++;
+            TrackSegment run;
+            run.firstCell  = start * cols + c;
+            run.lastCell   = r * cols + c;
+            run.step       = cols;
+            run.endNode[0] = endNodeAt(ctx, start - 1, c);
+            run.endNode[1] = endNodeAt(ctx, r + 1, c);
+            for (int cell = run.firstCell; cell <= run.lastCell; cell += cols) {
+                ctx.tileInfo[cell].segment = (int)graph->segments.size();
+            }
+            graph->segments.push_back(run);
+        }
+    }
+
+    ctx.trackGraph = graph;
+    return true;
+}
+
+void releaseTrackGraph(SimulationContext &ctx) {
+    delete ctx.trackGraph;
+    ctx.trackGraph = 0;
+}
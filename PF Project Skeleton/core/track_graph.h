@@ -0,0 +1,48 @@
+#ifndef TRACK_GRAPH_H
+#define TRACK_GRAPH_H
+
+// ============================================================================
+// TRACK_GRAPH.H - Compressed track graph
+// ============================================================================
+// Straight runs of '-', '|' and '=' between the interesting tiles (switches,
+// crossings, curves, spawns, destinations) are collapsed into segments; the
+// interesting tiles are the nodes at their ends. A run tile only joins a
+// segment if no tile beside it can send a train into it sideways, so inside
+// a segment trains can only meet trains on the same segment.
+// ============================================================================
+
+#include "simulation_state.h"
+#include <vector>
+
+struct TrackSegment {
+    int firstCell;        //Cell at the top/left end
+    int lastCell;         //Cell at the bottom/right end
+    int step;             //Cell index step along the run (1 or number_column)
+    int endNode[2];       //Track cell before firstCell / after lastCell, or -1
+};
+
+//Each run tile's TileInfo::segment indexes `segments`; nodes keep -1
+struct TrackGraph {
+    std::vector<TrackSegment> segments;
+};
+
+// Build the graph from the tile records (after loading, or after the map changes).
+bool buildTrackGraph(SimulationContext &ctx);
+
+// Free the graph.
+void releaseTrackGraph(SimulationContext &ctx);
+
+// ----------------------------------------------------------------------------
+// Next cell of a train on cell `cell` heading `dir`, when both cells lie in
+// one segment. Returns the segment, or -1 when the move has to go through
+// the full per-tile path.
+// ----------------------------------------------------------------------------
+inline int segmentStep(const SimulationContext &ctx, int cell, int dir, int &next) {
+    int segment = ctx.tileInfo[cell].segment;
+    if (segment < 0) return -1;
+    next = cell + row_change[dir] * ctx.number_column + column_change[dir];
+    if (next < 0 || next >= ctx.number_rows * ctx.number_column) return -1;
+    return ctx.tileInfo[next].segment == segment ? segment : -1;
+}
+
+#endif
@@ -2,6 +2,8 @@
 #include "simulation_state.h"
 #include "grid.h"
 #include "switches.h"
+#include "routing.h"
+#include "track_graph.h"
 #include <cstdlib>
 #include <iostream>
 
@@ -14,25 +16,51 @@ using namespace std;
 // ---------------------------------------------------------------------------
 // Helper: get the destination assigned to a specific train.
 // Destinations are stored by *destination index*, and mapped to trains via
-// destinationTrainID[d] == trainID.
+// destinationTrainID[d] == trainID. trainDestination caches the first such d.
 // ---------------------------------------------------------------------------
-static bool getDestinationForTrain(int trainID, int &destRow, int &destCol) {
-    for (int d = 0; d < numDest; ++d) {
-        if (destinationTrainID[d] == trainID) {
-            destRow = destinationRow[d];
-            destCol = destinationColumn[d];
-            return true;
-        }
-    }
+static int getDestinationIndexForTrain(const SimulationContext &ctx, int trainID) {
+    int d = ctx.trainDestination[trainID];
     // Fallback: if no explicit assignment but destinations exist,
     // just use the first one. If there are no destinations at all,
-    // return false.
-    if (numDest > 0) {
-        destRow = destinationRow[0];
-        destCol = destinationColumn[0];
-        return true;
+    // return -1.
+    if (d == -1 && ctx.numDest > 0) d = 0;
+    return d;
+}
+
+static bool getDestinationForTrain(const SimulationContext &ctx, int trainID, int &destRow, int &destCol) {
+    int d = getDestinationIndexForTrain(ctx, trainID);
+    if (d == -1) return false;
+    destRow = ctx.destinationRow[d];
+    destCol = ctx.destinationColumn[d];
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Helper: how far a train would be from delivery after arriving at row,col
+// with `heading`. Uses the track distance field, or Manhattan distance to its
+// destination when there is no field or no track path. 0 without a destination.
+// ---------------------------------------------------------------------------
+static int getRemainingDistance(const SimulationContext &ctx, int trainID, int row, int col, int heading) {
+    int d = getDestinationIndexForTrain(ctx, trainID);
+    if (d == -1) return 0;
+    int ticks = routeDistance(ctx, row, col, heading);
+    if (ticks >= 0) return ticks;
+    return abs(row - ctx.destinationRow[d]) + abs(col - ctx.destinationColumn[d]);
+}
+
+// ---------------------------------------------------------------------------
+// Helper: recompute trainDestination for one slot after destinationTrainID
+// changed (only happens on spawns and arrivals).
+// ---------------------------------------------------------------------------
+static void refreshTrainDestination(SimulationContext &ctx, int trainID) {
+    if (trainID < 0 || trainID >= ctx.trainCapacity) return;
+    ctx.trainDestination[trainID] = -1;
+    for (int d = 0; d < ctx.numDest; ++d) {
+        if (ctx.destinationTrainID[d] == trainID) {
+            ctx.trainDestination[trainID] = d;
+            return;
+        }
     }
-    return false;
 }
 
 // ----------------------------------------------------------------------------
@@ -40,15 +68,15 @@ static bool getDestinationForTrain(int trainID, int &destRow, int &destCol) {
 // ----------------------------------------------------------------------------
 // Activate trains scheduled for this tick.
 // ----------------------------------------------------------------------------
-void spawnTrainsForTick() {
+void spawnTrainsForTick(SimulationContext &ctx) {
     // Check all spawn instructions
-    for (int i = 0; i < num_spawn; i++) {
-        if (spawnTick[i] == currentTick && spawnTrainID[i] == -1) {
+    for (int i = 0; i < ctx.num_spawn; i++) {
+        if (ctx.spawnTick[i] == ctx.currentTick && ctx.spawnTrainID[i] == -1) {
 
             // Find a free train slot
             int freeTrain = -1;
-            for (int j = 0; j < max_trains; j++) {
-                if (trainRow[j] == -1) {
+            for (int j = 0; j < ctx.trainCapacity; j++) {
+                if (ctx.trainRow[j] == -1) {
                     freeTrain = j;
                     break;
                 }
@@ -60,9 +88,9 @@ void spawnTrainsForTick() {
 
             // If spawn tile is already occupied, skip this spawn this tick
             bool occupied = false;
-            for (int k = 0; k < max_trains; k++) {
-                if (trainRow[k] == spawnn_Row[i] &&
-                    trainColumn[k] == spawnn_Column[i]) {
+            for (int k = 0; k < ctx.trainCapacity; k++) {
+                if (ctx.trainRow[k] == ctx.spawnn_Row[i] &&
+                    ctx.trainColumn[k] == ctx.spawnn_Column[i]) {
                     occupied = true;
                     break;
                 }
@@ -70,26 +98,28 @@ void spawnTrainsForTick() {
             if (occupied) continue;
 
             // Spawn train
-            trainRow[freeTrain]       = spawnn_Row[i];
-            trainColumn[freeTrain]    = spawnn_Column[i];
-            trainDirection[freeTrain] = spawnDirection[i];
-            trainColor[freeTrain]     = spawnColor[i];
-            trainWait[freeTrain]      = 0;
+            ctx.trainRow[freeTrain]       = ctx.spawnn_Row[i];
+            ctx.trainColumn[freeTrain]    = ctx.spawnn_Column[i];
+            ctx.trainDirection[freeTrain] = ctx.spawnDirection[i];
+            ctx.trainColor[freeTrain]     = ctx.spawnColor[i];
+            ctx.trainWait[freeTrain]      = 0;
 
-            spawnTrainID[i] = freeTrain;  // Mark instruction as spawned
+            ctx.spawnTrainID[i] = freeTrain;  // Mark instruction as spawned
 
             // Re-map this destination from "spawn index" to actual train ID
-            for (int d = 0; d < numDest; d++) {
-                if (destinationTrainID[d] == i) {
-                    destinationTrainID[d] = freeTrain;
+            for (int d = 0; d < ctx.numDest; d++) {
+                if (ctx.destinationTrainID[d] == i) {
+                    ctx.destinationTrainID[d] = freeTrain;
                 }
             }
+            refreshTrainDestination(ctx, i);
+            refreshTrainDestination(ctx, freeTrain);
 
             // NOTE: numOf_trains is treated as "highest used train index + 1".
             // It is *not* decremented when trains reach/crash, but that is OK
             // because we check trainRow[i] == -1 everywhere.
-            if (freeTrain + 1 > numOf_trains) {
-                numOf_trains = freeTrain + 1;
+            if (freeTrain + 1 > ctx.numOf_trains) {
+                ctx.numOf_trains = freeTrain + 1;
             }
         }
     }
@@ -101,88 +131,40 @@ void spawnTrainsForTick() {
 // Compute next position from current tile and direction.
 // Returns false if the move would go out of bounds or onto an invalid tile.
 // ----------------------------------------------------------------------------
-bool determineNextPosition(int trainID, int &nextRow, int &nextColumn) {
-    nextRow    = trainRow[trainID]    + row_change[trainDirection[trainID]];
-    nextColumn = trainColumn[trainID] + column_change[trainDirection[trainID]];
-
-    // Correct bounds check (row vs number_rows, col vs number_column)
-    if (!isInBounds(nextRow, nextColumn)) {
-        return false;
-    }
-
-    char nextTile = grid[nextRow][nextColumn];
-
-    // Only allow moving onto valid tiles
-    if (!(isTrackTile(nextRow, nextColumn) ||
-          isSwitchTile(nextRow, nextColumn) ||
-          nextTile == spawn ||
-          nextTile == destination ||
-          nextTile == '=')) {
-        return false;
-    }
-
-    return true;
+bool determineNextPosition(const SimulationContext &ctx, int trainID, int &nextRow, int &nextColumn) {
+    int row = ctx.trainRow[trainID];
+    int col = ctx.trainColumn[trainID];
+    int dir = ctx.trainDirection[trainID];
+    nextRow    = row + row_change[dir];
+    nextColumn = col + column_change[dir];
+
+    // Only allow moving onto valid in-bounds tiles (precomputed per tile)
+    return (ctx.tileInfo[row * ctx.number_column + col].trackMask >> dir) & 1;
 }
 
 // ----------------------------------------------------------------------------
 // GET NEXT DIRECTION based on current tile and direction
 // ----------------------------------------------------------------------------
-// Return new direction after entering the tile.
-// ----------------------------------------------------------------------------
-int getNextDirection(int trainID, int row, int col) {
-    char track = grid[row][col];   // Tile train is currently on
-
-     if(track=='='){
-        track=originalGrid[trainRow[trainID]][trainColumn[trainID]];
-        // If original is safety track treat as horizontal track
-        if(track == '=') track = '-';
-    }
-    //Normal track logic
-    switch (track) {
-        case spawn:
-        case destination:
-        case '=':
-        case horizontal_track:
-            // Horizontal track: only LEFT or RIGHT is valid
-            if (trainDirection[trainID] == left_dir) {
-                return left_dir;
-            } else {
-                return right_dir;
-            }
-
-        case vertical_track:
-            // Vertical track: only UP or DOWN is valid
-            if (trainDirection[trainID] == up_dir) {
-                return up_dir;
-            } else {
-                return down_dir;
-            }
-
-        case right_curve:
-            if (trainDirection[trainID] == up_dir)        return right_dir;
-            else if (trainDirection[trainID] == left_dir) return down_dir;
-            break;
-
-        case left_curve:
-            if (trainDirection[trainID] == up_dir)         return left_dir;
-            else if (trainDirection[trainID] == right_dir) return down_dir;
-            break;
-
-        case crossing:
-            // Smart routing at '+'
-            return getSmartDirectionAtCrossing(trainID);
-
-        default:
-            break;
+// Return new direction after entering the tile. Plain track is a table
+// lookup; only switches and crossings take the slow path.
+// ----------------------------------------------------------------------------
+int getNextDirection(const SimulationContext &ctx, int trainID, int row, int col) {
+    const TileInfo &here = ctx.tileInfo[row * ctx.number_column + col];
+    int turn = turnTable[here.routeClass][ctx.trainDirection[trainID]];
+    if (turn != route_dynamic) return turn;
+
+    if (here.routeClass == tile_crossing) {
+        // Smart routing at '+'
+        return getSmartDirectionAtCrossing(ctx, trainID);
     }
 
     // --- SWITCH LOGIC ---
-    // If we are currently standing on a switch tile, choose direction
+    // We are standing on a switch tile, choose direction
     // based on switchState[switchID].
-    if (isSwitchTile(row, col)) {
-        int switchID = getSwitchIndex(row, col);
+    if (here.switchIndex >= 0) {
+        int switchID = here.switchIndex;
 
-        int currentDir = trainDirection[trainID];
+        int currentDir = ctx.trainDirection[trainID];
 
         int straight = currentDir;
         int right    = (currentDir + 1) % 4;
@@ -196,7 +178,7 @@ int getNextDirection(int trainID, int row, int col) {
         // Use switchState[switchID] to decide branch order.
         // 0 => prefer left then right
         // 1 => prefer right then left
-        if (switchState[switchID] == 0) {
+        if (ctx.switchState[switchID] == 0) {
             candidates[1] = left;
             candidates[2] = right;
         } else {
@@ -207,59 +189,59 @@ int getNextDirection(int trainID, int row, int col) {
 
         // Find the first candidate that leads to a valid tile
         for (int k = 0; k < 4; k++) {
-            int dir    = candidates[k];
-            int newRow = row + row_change[dir];
-            int newCol = col + column_change[dir];
-
-            if (!isInBounds(newRow, newCol)) continue;
-
-            char newTile = grid[newRow][newCol];
-            bool valid = (isTrackTile(newRow, newCol) ||
-                          isSwitchTile(newRow, newCol) ||
-                          newTile == spawn ||
-                          newTile == destination ||
-                          newTile == '=');
-
-            if (valid) {
+            int dir = candidates[k];
+            if ((here.trackMask >> dir) & 1) {
                 return dir;
             }
         }
     }
 
     // Default: keep current direction
-    return trainDirection[trainID];
+    return ctx.trainDirection[trainID];
 }
 // ----------------------------------------------------------------------------
 // SMART ROUTING AT CROSSING - Route train to its matched destination
 // ----------------------------------------------------------------------------
-// Choose best direction at '+' toward the *correct* destination for this train.
+// Choose best direction at '+' toward delivery. Follows the track distance
+// field (any destination delivers a train) when one is reachable, otherwise
+// heads for the neighbour closest to this train's destination (Manhattan).
 // ----------------------------------------------------------------------------
-int getSmartDirectionAtCrossing(int trainID) {
-    int row    = trainRow[trainID];
-    int column = trainColumn[trainID];
+int getSmartDirectionAtCrossing(const SimulationContext &ctx, int trainID) {
+    int row    = ctx.trainRow[trainID];
+    int column = ctx.trainColumn[trainID];
 
     int destRow, destCol;
-    if (!getDestinationForTrain(trainID, destRow, destCol)) {
+    if (!getDestinationForTrain(ctx, trainID, destRow, destCol)) {
         // No destination assigned, just keep going straight
-        return trainDirection[trainID];
+        return ctx.trainDirection[trainID];
+    }
+
+    // Can't move off the grid or onto empty tiles
+    unsigned char openMask = ctx.tileInfo[row * ctx.number_column + column].openMask;
+
+    // Shortest track path: one field read per neighbour
+    int bestDir  = -1;
+    int minTicks = 0;
+    for (int i = 0; i < 4; i++) {
+        if (!((openMask >> i) & 1)) continue;
+        int ticks = routeDistance(ctx, row + row_change[i], column + column_change[i], i);
+        if (ticks >= 0 && (bestDir == -1 || ticks < minTicks)) {
+            minTicks = ticks;
+            bestDir  = i;
+        }
     }
+    if (bestDir != -1) return bestDir;
 
-    int bestDir    = trainDirection[trainID];
+    bestDir = ctx.trainDirection[trainID];
     int minDistance = abs(row - destRow) + abs(column - destCol);    // Manhattan distance
 
     // Check all 4 possible directions
     for (int i = 0; i < 4; i++) {
+        if (!((openMask >> i) & 1)) continue;
+
         int nrow    = row    + row_change[i];
         int ncolumn = column + column_change[i];
 
-        // this bug was causing the issues(corrected now)
-        if (nrow < 0 || nrow >= number_rows ||
-            ncolumn < 0 || ncolumn >= number_column)
-            continue;
-
-        char tile = grid[nrow][ncolumn];
-        if (tile == space) continue; // Can't move onto empty tiles
-
         int dist = abs(nrow - destRow) + abs(ncolumn - destCol);
         if (dist < minDistance) {
             minDistance = dist;
@@ -275,16 +257,176 @@ int getSmartDirectionAtCrossing(int trainID) {
 // ----------------------------------------------------------------------------
 // Fill next directions for all trains using local rules.
 // ----------------------------------------------------------------------------
-void determineAllRoutes() {
-    for (int i = 0; i < numOf_trains; i++) {
-        if (trainRow[i] == -1) continue; // inactive
+void determineAllRoutes(SimulationContext &ctx) {
+    for (int i = 0; i < ctx.numOf_trains; i++) {
+        if (ctx.trainRow[i] == -1) continue; // inactive
         // If already at destination, do nothing
-        if (isDestinationPoint(trainRow[i], trainColumn[i])) {
+        if (isDestinationPoint(ctx, ctx.trainRow[i], ctx.trainColumn[i])) {
             continue;
         }
         // Determine next direction based on current tile
-        trainDirection[i] = getNextDirection(i, trainRow[i], trainColumn[i]);
+        ctx.trainDirection[i] = getNextDirection(ctx, i, ctx.trainRow[i], ctx.trainColumn[i]);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Collision index helpers.
+// Every tile keeps two ascending lists of train IDs: trains planning to enter
+// it and trains standing on it. A tile's list heads are only valid while its
+// stamp matches the current tick's stamp, so nothing has to be cleared.
+// ---------------------------------------------------------------------------
+static TileIndex& tileEntry(SimulationContext &ctx, int row, int col) {
+    TileIndex &entry = ctx.tileIndex[row * ctx.number_column + col];
+    if (entry.stamp != ctx.collisionIndexStamp) {
+        entry.stamp        = ctx.collisionIndexStamp;
+        entry.plannedHead  = -1;
+        entry.occupantHead = -1;
+    }
+    return entry;
+}
+
+static int* plannedHead(SimulationContext &ctx, int row, int col) {
+    return &tileEntry(ctx, row, col).plannedHead;
+}
+
+static int* occupantHead(SimulationContext &ctx, int row, int col) {
+    return &tileEntry(ctx, row, col).occupantHead;
+}
+
+static void linkTrain(int *head, int link[], int trainID) {
+    while (*head != -1 && *head < trainID) head = &link[*head];
+    link[trainID] = *head;
+    *head = trainID;
+}
+
+static void unlinkTrain(int *head, int link[], int trainID) {
+    while (*head != -1 && *head != trainID) head = &link[*head];
+    if (*head == trainID) *head = link[trainID];
+}
+
+// Start a new tick's index (wraps the stamp instead of overflowing)
+static void resetCollisionIndex(SimulationContext &ctx) {
+    ctx.collisionIndexStamp++;
+    if (ctx.collisionIndexStamp <= 0) {
+        int cells = ctx.number_rows * ctx.number_column;
+        for (int c = 0; c < cells; c++) ctx.tileIndex[c].stamp = 0;
+        ctx.collisionIndexStamp = 1;
+    }
+}
+
+// Add a train's current tile to the index
+// (trains sharing a tile are marked -1 in plannedOnSegment)
+static void indexOccupant(SimulationContext &ctx, int trainID) {
+    int *head = occupantHead(ctx, ctx.trainRow[trainID], ctx.trainColumn[trainID]);
+    linkTrain(head, ctx.occupantLink, trainID);
+    if (*head != trainID) {
+        ctx.plannedOnSegment[*head]   = -1;
+        ctx.plannedOnSegment[trainID] = -1;
+    }
+}
+
+// Add a train's planned tile to the index
+static void indexPlanned(SimulationContext &ctx, int nextRow[], int nextCol[], int trainID) {
+    if (nextRow[trainID] != -1) {
+        linkTrain(plannedHead(ctx, nextRow[trainID], nextCol[trainID]),
+                  ctx.plannedLink, trainID);
+    }
+}
+
+// First train standing on a cell this tick, or -1 (read only)
+static int firstOccupant(const SimulationContext &ctx, int cell) {
+    const TileIndex &entry = ctx.tileIndex[cell];
+    return entry.stamp == ctx.collisionIndexStamp ? entry.occupantHead : -1;
+}
+
+// ---------------------------------------------------------------------------
+// Segment fast path.
+// On a track segment only trains on the same straight run can reach the
+// next tile (see track_graph.h). A train alone on its tile conflicts with
+// nobody when its next tile is empty and no train one tile further heads
+// back at it, or when the train on its next tile was already cleared here
+// (and so certainly moves on). Its move is then plain index arithmetic and
+// it stays out of the planned index. Needs every train's current tile
+// indexed first.
+// ---------------------------------------------------------------------------
+static bool segmentClear(const SimulationContext &ctx, int cell, int dir) {
+    int next;
+    int segment = segmentStep(ctx, cell, dir, next);
+    if (segment < 0) return false;
+
+    // Following a train this path already cleared: it moves on for certain
+    int j = firstOccupant(ctx, next);
+    if (j != -1) return ctx.plannedOnSegment[j] == 1;
+
+    int beyond = next + (next - cell);
+    if (beyond < 0 || beyond >= ctx.number_rows * ctx.number_column) return true;
+    j = firstOccupant(ctx, beyond);
+    // On a node the train's next move is not known yet
+    if (j != -1 && ctx.tileInfo[beyond].segment != segment) return false;
+    for (; j != -1; j = ctx.occupantLink[j]) {
+        if (ctx.trainDirection[j] == (dir + 2) % 4) return false;
     }
+    return true;
+}
+
+static bool planSegmentMove(SimulationContext &ctx, int nextRow[], int nextCol[], int trainID) {
+    if (ctx.plannedOnSegment[trainID] != 0) return false;     // Shares its tile
+    int dir = ctx.trainDirection[trainID];
+    if (!segmentClear(ctx, ctx.trainRow[trainID] * ctx.number_column + ctx.trainColumn[trainID], dir)) {
+        return false;
+    }
+    nextRow[trainID] = ctx.trainRow[trainID] + row_change[dir];
+    nextCol[trainID] = ctx.trainColumn[trainID] + column_change[dir];
+    return true;
+}
+
+// Change a train's planned tile (-1 = removed) and keep the index in step
+static void replanTrain(SimulationContext &ctx, int nextRow[], int nextCol[],
+                        int trainID, int row, int col) {
+    if (nextRow[trainID] != -1) {
+        unlinkTrain(plannedHead(ctx, nextRow[trainID], nextCol[trainID]),
+                    ctx.plannedLink, trainID);
+    }
+    nextRow[trainID] = row;
+    nextCol[trainID] = col;
+    if (row != -1) {
+        linkTrain(plannedHead(ctx, row, col), ctx.plannedLink, trainID);
+    }
+}
+
+// Remove a crashed train from the map and the index, halting the area
+static void crashTrain(SimulationContext &ctx, int nextRow[], int nextCol[], int trainID) {
+    replanTrain(ctx, nextRow, nextCol, trainID, -1, -1);
+    if (ctx.trainRow[trainID] != -1) {
+        triggerEmergencyHalt(ctx, ctx.trainRow[trainID], ctx.trainColumn[trainID], emergency_halt_ticks);
+        unlinkTrain(occupantHead(ctx, ctx.trainRow[trainID], ctx.trainColumn[trainID]),
+                    ctx.occupantLink, trainID);
+    }
+    ctx.trainRow[trainID]    = -1;
+    ctx.trainColumn[trainID] = -1;
+}
+
+// ---------------------------------------------------------------------------
+// Lowest train j > after that conflicts with train i: it plans to enter the
+// same tile, or it stands on i's next tile while heading for i's tile (swap).
+// Returns -1 if there is none.
+// ---------------------------------------------------------------------------
+static int nextConflict(SimulationContext &ctx, int nextRow[], int nextCol[], int i, int after) {
+    int best = -1;
+
+    int j = *plannedHead(ctx, nextRow[i], nextCol[i]);
+    while (j != -1 && j <= after) j = ctx.plannedLink[j];
+    if (j != -1) best = j;
+
+    j = *occupantHead(ctx, nextRow[i], nextCol[i]);
+    while (j != -1 && (best == -1 || j < best)) {
+        if (j > after && nextRow[j] == ctx.trainRow[i] && nextCol[j] == ctx.trainColumn[i]) {
+            best = j;
+            break;
+        }
+        j = ctx.occupantLink[j];
+    }
+    return best;
 }
 
 // ----------------------------------------------------------------------------
@@ -292,74 +434,109 @@ void determineAllRoutes() {
 // ----------------------------------------------------------------------------
 // Move trains; resolve collisions and apply effects.
 // ----------------------------------------------------------------------------
-void moveAllTrains() {
-    int nextRow[max_trains];
-    int nextCol[max_trains];
-    int nextDir[max_trains];
-    int oldRow[max_trains];
-    int oldCol[max_trains];
-
-    // Plan moves
-    for (int i = 0; i < numOf_trains; i++) {
-        if (trainRow[i] == -1) {
+void moveAllTrains(SimulationContext &ctx) {
+    // Per-train scratch lives in the world arena
+    int *nextRow = ctx.plannedRow;
+    int *nextCol = ctx.plannedColumn;
+    int *nextDir = ctx.plannedDirection;
+    int *oldRow  = ctx.previousRow;
+    int *oldCol  = ctx.previousColumn;
+
+    int *onSegment = ctx.plannedOnSegment;
+
+    // Index where every train stands, then plan moves, indexing planned
+    // tiles for collision checks
+    resetCollisionIndex(ctx);
+    for (int i = 0; i < ctx.numOf_trains; i++) {
+        onSegment[i] = 0;
+        if (ctx.trainRow[i] != -1) indexOccupant(ctx, i);
+    }
+    for (int i = 0; i < ctx.numOf_trains; i++) {
+        if (ctx.trainRow[i] == -1) {
             // inactive train
             nextRow[i] = -1;
             nextCol[i] = -1;
-            nextDir[i] = trainDirection[i];
+            nextDir[i] = ctx.trainDirection[i];
             continue;
         }
 
         // If the train is already waiting (safety tile/emergency halt) then it don't move
-        if (trainWait[i] > 0) {
-            nextRow[i] = trainRow[i];
-            nextCol[i] = trainColumn[i];
-            nextDir[i] = trainDirection[i];
-            trainWait[i]--;
-            totalWaitTicks++;
+        if (ctx.trainWait[i] > 0) {
+            nextRow[i] = ctx.trainRow[i];
+            nextCol[i] = ctx.trainColumn[i];
+            nextDir[i] = ctx.trainDirection[i];
+            ctx.trainWait[i]--;
+            ctx.totalWaitTicks++;
+            indexPlanned(ctx, nextRow, nextCol, i);
+            continue;
+        }
+
+        // Clear straight run: the heading is kept and nothing can conflict
+        if (ctx.trackGraph && planSegmentMove(ctx, nextRow, nextCol, i)) {
+            nextDir[i]   = ctx.trainDirection[i];
+            onSegment[i] = 1;
             continue;
         }
 
         // Compute next position
-        if (!determineNextPosition(i, nextRow[i], nextCol[i])) {
+        if (!determineNextPosition(ctx, i, nextRow[i], nextCol[i])) {
             // IMPORTANT CHANGE:
             // we treatt leaving the track / out-of-bound  as a crash.
             // Otherwise the train would stay stuck forever and block others.
-            trainRow[i]    = -1;
-            trainColumn[i] = -1;
+            triggerEmergencyHalt(ctx, ctx.trainRow[i], ctx.trainColumn[i], emergency_halt_ticks);
+            unlinkTrain(occupantHead(ctx, ctx.trainRow[i], ctx.trainColumn[i]),
+                        ctx.occupantLink, i);
+            ctx.trainRow[i]    = -1;
+            ctx.trainColumn[i] = -1;
             nextRow[i]     = -1;
             nextCol[i]     = -1;
-            crashed_trains++;
+            ctx.crashed_trains++;
             continue;
         }
 
         // Compute next direction (based on the tile we're leaving)
-        nextDir[i] = getNextDirection(i, trainRow[i], trainColumn[i]);
+        nextDir[i] = getNextDirection(ctx, i, ctx.trainRow[i], ctx.trainColumn[i]);
+        indexPlanned(ctx, nextRow, nextCol, i);
     }
 
     // Save previous positions for safety-tile detection
-    for (int i = 0; i < numOf_trains; i++) {
-        oldRow[i] = trainRow[i];
-        oldCol[i] = trainColumn[i];
+    for (int i = 0; i < ctx.numOf_trains; i++) {
+        oldRow[i] = ctx.trainRow[i];
+        oldCol[i] = ctx.trainColumn[i];
     }
 
     // Resolve collisions based on next positions
-    detectCollisions(nextRow, nextCol, nextDir);
+    detectCollisions(ctx, nextRow, nextCol, nextDir);
 
-    // Apply movements
-    for (int i = 0; i < numOf_trains; i++) {
+    // Apply movements, recording trains that move onto a switch
+    ctx.numSwitchEntries = 0;
+    for (int i = 0; i < ctx.numOf_trains; i++) {
         if (nextRow[i] != -1) {  // skip trains that are crashed
-            trainRow[i]       = nextRow[i];
-            trainColumn[i]    = nextCol[i];
-            trainDirection[i] = nextDir[i];
+            ctx.trainRow[i]       = nextRow[i];
+            ctx.trainColumn[i]    = nextCol[i];
+            ctx.trainDirection[i] = nextDir[i];
+
+            if (!(oldRow[i] == ctx.trainRow[i] && oldCol[i] == ctx.trainColumn[i]) &&
+                ctx.tileInfo[ctx.trainRow[i] * ctx.number_column + ctx.trainColumn[i]].tileClass == tile_switch) {
+                ctx.switchEntries[ctx.numSwitchEntries++] = i;
+            }
 
             // Check if train has entered a safety tile
-            char tile = grid[trainRow[i]][trainColumn[i]];
+            char tile = ctx.grid[ctx.trainRow[i]][ctx.trainColumn[i]];
             if (tile == '=') {
                 // Only set wait if we actually entered a new safety tile
-                if (!(oldRow[i] == trainRow[i] && oldCol[i] == trainColumn[i])) {
-                    trainWait[i] = 1;
+                if (!(oldRow[i] == ctx.trainRow[i] && oldCol[i] == ctx.trainColumn[i])) {
+                    ctx.trainWait[i] = 1;
                 }
             }
+
+            // Rain: a train that moved is sometimes slowed for a tick,
+            // drawn from the level's seeded random stream
+            if (ctx.weather_type == weather_rain &&
+                !(oldRow[i] == ctx.trainRow[i] && oldCol[i] == ctx.trainColumn[i]) &&
+                nextRandom(ctx) % rain_slowdown_chance == 0) {
+                ctx.trainWait[i] = 1;
+            }
         }
     }
 }
@@ -367,111 +544,77 @@ void moveAllTrains() {
 // ----------------------------------------------------------------------------
 // DETECT COLLISIONS WITH PRIORITY SYSTEM
 // ----------------------------------------------------------------------------
-void detectCollisions(int nextRow[], int nextCol[], int nextDir[]) {
-    for (int i = 0; i < numOf_trains; i++) {
-        if (trainRow[i] == -1) continue; // inactive
+// Uses the per-tile index built by moveAllTrains, so each train only visits
+// the trains it actually conflicts with, in the same (i, j) order as a full
+// pairwise scan. Trains moved by the segment fast path are skipped.
+// ----------------------------------------------------------------------------
+void detectCollisions(SimulationContext &ctx, int nextRow[], int nextCol[], int nextDir[]) {
+    (void)nextDir;
+    for (int i = 0; i < ctx.numOf_trains; i++) {
+        if (ctx.trainRow[i] == -1) continue; // inactive
+        if (ctx.plannedOnSegment[i] == 1) continue; // segment fast path: no conflicts
 
-        for (int j = i + 1; j < numOf_trains; j++) {
-            if (trainRow[j] == -1) continue;
+        int j = i;
+        while (nextRow[i] != -1) {
+            j = nextConflict(ctx, nextRow, nextCol, i, j);
+            if (j == -1) break;
 
             // SAME-TILE collision: both try to move to same cell
             if (nextRow[i] == nextRow[j] && nextCol[i] == nextCol[j]) {
-                // If one or both are already removed then we skip
-                if (nextRow[i] == -1 || nextRow[j] == -1) continue;
-
-                char tile = grid[nextRow[i]][nextCol[i]];
-
-                int destRi, destCi, destRj, destCj;
-                int dist_i = 0, dist_j = 0;
-
-                if (getDestinationForTrain(i, destRi, destCi))
-                    dist_i = abs(nextRow[i] - destRi) + abs(nextCol[i] - destCi);
-                if (getDestinationForTrain(j, destRj, destCj))
-                    dist_j = abs(nextRow[j] - destRj) + abs(nextCol[j] - destCj);
+                int dist_i = getRemainingDistance(ctx, i, nextRow[i], nextCol[i], ctx.trainDirection[i]);
+                int dist_j = getRemainingDistance(ctx, j, nextRow[j], nextCol[j], ctx.trainDirection[j]);
 
                 if (dist_i == dist_j) {
                     // Both crash
-                    nextRow[i]    = -1;
-                    nextCol[i]    = -1;
-                    nextRow[j]    = -1;
-                    nextCol[j]    = -1;
-                    trainRow[i]   = -1;
-                    trainColumn[i]= -1;
-                    trainRow[j]   = -1;
-                    trainColumn[j]= -1;
-                    crashed_trains += 2;
+                    crashTrain(ctx, nextRow, nextCol, i);
+                    crashTrain(ctx, nextRow, nextCol, j);
+                    ctx.crashed_trains += 2;
                 } else if (dist_i > dist_j) {
                     // Train i is farther from its destination so it moves
-                    nextRow[j] = trainRow[j];
-                    nextCol[j] = trainColumn[j];
+                    replanTrain(ctx, nextRow, nextCol, j, ctx.trainRow[j], ctx.trainColumn[j]);
                 } else {
                     // Train j is farther from its destination so it moves
-                    nextRow[i] = trainRow[i];
-                    nextCol[i] = trainColumn[i];
+                    replanTrain(ctx, nextRow, nextCol, i, ctx.trainRow[i], ctx.trainColumn[i]);
                 }
             }
 
             // HEAD-ON swap collision: trains swap positions
-            else if (nextRow[i] == trainRow[j] && nextCol[i] == trainColumn[j] &&
-                     nextRow[j] == trainRow[i] && nextCol[j] == trainColumn[i]) {
-
-                // If one or both already removed, skip
-                if (nextRow[i] == -1 || nextRow[j] == -1) continue;
-
+            else {
                 //Check if straight track only
-                char tile_i = grid[trainRow[i]][trainColumn[i]];
-                char tile_j = grid[trainRow[j]][trainColumn[j]];
+                char tile_i = ctx.grid[ctx.trainRow[i]][ctx.trainColumn[i]];
+                char tile_j = ctx.grid[ctx.trainRow[j]][ctx.trainColumn[j]];
     
                 // If current tile is safety, check original tile
-                if (tile_i == '=') tile_i = originalGrid[trainRow[i]][trainColumn[i]];
-                if (tile_j == '=') tile_j = originalGrid[trainRow[j]][trainColumn[j]];
+                if (tile_i == '=') tile_i = ctx.originalGrid[ctx.trainRow[i]][ctx.trainColumn[i]];
+                if (tile_j == '=') tile_j = ctx.originalGrid[ctx.trainRow[j]][ctx.trainColumn[j]];
     
                 // If both trains are on straight tracks (not crossings), they MUST crash
                 bool isStraightTrack_i = (tile_i == '|' || tile_i == '-');
                 bool isStraightTrack_j = (tile_j == '|' || tile_j == '-');
-                bool isSafety_i = (grid[trainRow[i]][trainColumn[i]] == '=');
-                bool isSafety_j = (grid[trainRow[j]][trainColumn[j]] == '=');
+                bool isSafety_i = (ctx.grid[ctx.trainRow[i]][ctx.trainColumn[i]] == '=');
+                bool isSafety_j = (ctx.grid[ctx.trainRow[j]][ctx.trainColumn[j]] == '=');
     
-                if(isStraightTrack_i && isStraightTrack_j || isSafety_i || isSafety_j){
+                if((isStraightTrack_i && isStraightTrack_j) || isSafety_i || isSafety_j){
                     //Crash Trains if no path avaliable
-                    nextRow[i]=-1;
-                    nextCol[i]=-1;
-                    nextRow[j]=-1;
-                    nextCol[j]=-1;
-                    trainRow[i]=-1;
-                    trainColumn[i]=-1;
-                    trainRow[j]=-1;
-                    trainColumn[j]=-1;
-                    crashed_trains+=2;
+                    crashTrain(ctx, nextRow, nextCol, i);
+                    crashTrain(ctx, nextRow, nextCol, j);
+                    ctx.crashed_trains+=2;
                     continue; //Skip manhattan distance check
                 }
-                int destRi, destCi, destRj, destCj;
-                int dist_i = 0, dist_j = 0;
-
-                if (getDestinationForTrain(i, destRi, destCi))
-                    dist_i = abs(nextRow[i] - destRi) + abs(nextCol[i] - destCi);
-                if (getDestinationForTrain(j, destRj, destCj))
-                    dist_j = abs(nextRow[j] - destRj) + abs(nextCol[j] - destCj);
+                int dist_i = getRemainingDistance(ctx, i, nextRow[i], nextCol[i], ctx.trainDirection[i]);
+                int dist_j = getRemainingDistance(ctx, j, nextRow[j], nextCol[j], ctx.trainDirection[j]);
 
                 if (dist_i == dist_j) {
                     // Both crash
-                    nextRow[i]     = -1;
-                    nextCol[i]     = -1;
-                    nextRow[j]     = -1;
-                    nextCol[j]     = -1;
-                    trainRow[i]    = -1;
-                    trainColumn[i] = -1;
-                    trainRow[j]    = -1;
-                    trainColumn[j] = -1;
-                    crashed_trains += 2;
+                    crashTrain(ctx, nextRow, nextCol, i);
+                    crashTrain(ctx, nextRow, nextCol, j);
+                    ctx.crashed_trains += 2;
                 } else if (dist_i > dist_j) {
                     // i is farther from its destination so it moves
-                    nextRow[j] = trainRow[j];
-                    nextCol[j] = trainColumn[j];
+                    replanTrain(ctx, nextRow, nextCol, j, ctx.trainRow[j], ctx.trainColumn[j]);
                 } else {
                     // j is farther from its destination so it moves
-                    nextRow[i] = trainRow[i];
-                    nextCol[i] = trainColumn[i];
+                    replanTrain(ctx, nextRow, nextCol, i, ctx.trainRow[i], ctx.trainColumn[i]);
                 }
             }
         }
@@ -483,22 +626,26 @@ void detectCollisions(int nextRow[], int nextCol[], int nextDir[]) {
 // ----------------------------------------------------------------------------
 // Mark trains that reached destinations.
 // ----------------------------------------------------------------------------
-void checkArrivals() {
-    for (int i = 0; i < numOf_trains; i++) {
-        if (trainRow[i] == -1) continue; // inactive
+void checkArrivals(SimulationContext &ctx) {
+    for (int i = 0; i < ctx.numOf_trains; i++) {
+        if (ctx.trainRow[i] == -1) continue; // inactive
+        // Most trains are not on a destination tile
+        if (!isDestinationPoint(ctx, ctx.trainRow[i], ctx.trainColumn[i])) continue;
 
-        for (int j = 0; j < numDest; j++) {
+        for (int j = 0; j < ctx.numDest; j++) {
             // If thee train is exactly at a destination coordinate
-            if (trainRow[i] == destinationRow[j] &&
-                trainColumn[i] == destinationColumn[j]) {
+            if (ctx.trainRow[i] == ctx.destinationRow[j] &&
+                ctx.trainColumn[i] == ctx.destinationColumn[j]) {
 
-                trainsReached++;
-                trainRow[i]    = -1;
-                trainColumn[i] = -1;  // Train becomes inactive
+                ctx.trainsReached++;
+                ctx.trainRow[i]    = -1;
+                ctx.trainColumn[i] = -1;  // Train becomes inactive
 
                 // over here we clear this destination's train mapping if it belonged to this train
-                if (destinationTrainID[j] == i)
-                    destinationTrainID[j] = -1;
+                if (ctx.destinationTrainID[j] == i) {
+                    ctx.destinationTrainID[j] = -1;
+                    refreshTrainDestination(ctx, i);
+                }
 
                 break; // Stop checking other destinations for this train
             }
@@ -506,20 +653,66 @@ void checkArrivals() {
     }
 }
 
+// ----------------------------------------------------------------------------
+// TRIGGER EMERGENCY HALT
+// ----------------------------------------------------------------------------
+// Halt every train in the 3x3 zone around row,col for the next `ticks` ticks.
+// Called on crashes; can also be called directly (e.g. from the UI).
+// Returns false if the position is off the grid or ticks <= 0.
+// ----------------------------------------------------------------------------
+bool triggerEmergencyHalt(SimulationContext &ctx, int row, int col, int ticks) {
+    if (!isInBounds(ctx, row, col) || ticks <= 0) return false;
+    int expiry = ctx.currentTick + ticks;
+
+    // Stamp the zone's tiles with the latest end tick covering them
+    for (int r = row - emergency_halt_radius; r <= row + emergency_halt_radius; r++) {
+        for (int c = col - emergency_halt_radius; c <= col + emergency_halt_radius; c++) {
+            if (isInBounds(ctx, r, c) && ctx.emergencyHalt[r][c] < expiry) {
+                ctx.emergencyHalt[r][c] = expiry;
+            }
+        }
+    }
+
+    // Record the zone; a zone already centred here is just extended.
+    // When the list is full the zone that ends first gives up its slot.
+    int slot = -1;
+    for (int z = 0; z < ctx.numHaltZones; z++) {
+        if (ctx.haltZoneRow[z] == row && ctx.haltZoneColumn[z] == col) {
+            slot = z;
+            break;
+        }
+    }
+    if (slot == -1 && ctx.numHaltZones < max_halt_zones) {
+        slot = ctx.numHaltZones++;
+        ctx.haltZoneExpiry[slot] = 0;
+    }
+    if (slot == -1) {
+        slot = 0;
+        for (int z = 1; z < ctx.numHaltZones; z++) {
+            if (ctx.haltZoneExpiry[z] < ctx.haltZoneExpiry[slot]) slot = z;
+        }
+    }
+    ctx.haltZoneRow[slot]    = row;
+    ctx.haltZoneColumn[slot] = col;
+    if (ctx.haltZoneExpiry[slot] < expiry) ctx.haltZoneExpiry[slot] = expiry;
+    ctx.emergencyHaltActive = 1;
+    return true;
+}
+
 // ----------------------------------------------------------------------------
 // APPLY EMERGENCY HALT
 // ----------------------------------------------------------------------------
-// Apply halt to trains in the active zone.
+// Apply halt to trains in an active zone.
 // ----------------------------------------------------------------------------
-void applyEmergencyHalt() {
-    for (int i = 0; i < numOf_trains; i++) {
-        if (trainRow[i] != -1 &&
-            emergencyHalt[trainRow[i]][trainColumn[i]] > 0) {
+void applyEmergencyHalt(SimulationContext &ctx) {
+    if (!ctx.emergencyHaltActive) return;
 
-            int haltTicks = emergencyHalt[trainRow[i]][trainColumn[i]];
-            if (trainWait[i] < haltTicks) {
-                trainWait[i] = haltTicks;
-            }
+    for (int i = 0; i < ctx.numOf_trains; i++) {
+        if (ctx.trainRow[i] == -1) continue;
+
+        int haltTicks = ctx.emergencyHalt[ctx.trainRow[i]][ctx.trainColumn[i]] - ctx.currentTick;
+        if (haltTicks > 0 && ctx.trainWait[i] < haltTicks) {
+            ctx.trainWait[i] = haltTicks;
         }
     }
 }
@@ -527,15 +720,121 @@ void applyEmergencyHalt() {
 // ----------------------------------------------------------------------------
 // UPDATE EMERGENCY HALT
 // ----------------------------------------------------------------------------
-// Decrement timer and disable when done.
-// NOTE: fixed iteration order to match emergencyHalt[row][col].
+// Drop zones that end before the next tick and disable when none are left.
+// Tiles keep their end tick, which is already in the past for dropped zones.
 // ----------------------------------------------------------------------------
-void updateEmergencyHalt() {
-    for (int r = 0; r < number_rows; r++) {
-        for (int c = 0; c < number_column; c++) {
-            if (emergencyHalt[r][c] > 0) {
-                emergencyHalt[r][c]--;
-            }
+void updateEmergencyHalt(SimulationContext &ctx) {
+    int kept = 0;
+    for (int z = 0; z < ctx.numHaltZones; z++) {
+        if (ctx.haltZoneExpiry[z] > ctx.currentTick + 1) {
+            ctx.haltZoneRow[kept]    = ctx.haltZoneRow[z];
+            ctx.haltZoneColumn[kept] = ctx.haltZoneColumn[z];
+            ctx.haltZoneExpiry[kept] = ctx.haltZoneExpiry[z];
+            kept++;
         }
     }
-}
\ No newline at end of file
+    ctx.numHaltZones = kept;
+    ctx.emergencyHaltActive = (kept > 0);
+}
+
+// ---------------------------------------------------------------------------
+// Quiet tick helpers.
+// A quiet tick is one where every active train only sits out trainWait, so
+// its outcome can be worked out without running the tick phases.
+// ---------------------------------------------------------------------------
+
+// Tick until which the halt zone list keeps applying halts (0 if none)
+static int haltZonesEnd(const SimulationContext &ctx) {
+    int end = 0;
+    if (!ctx.emergencyHaltActive) return end;
+    for (int z = 0; z < ctx.numHaltZones; z++) {
+        if (ctx.haltZoneExpiry[z] > end) end = ctx.haltZoneExpiry[z];
+    }
+    return end;
+}
+
+// Tick the halt on a train's tile ends, or -1 if it is not applied this tick
+static int haltOnTrain(const SimulationContext &ctx, int trainID, int zonesEnd) {
+    int end = ctx.emergencyHalt[ctx.trainRow[trainID]][ctx.trainColumn[trainID]];
+    return (ctx.currentTick < end && ctx.currentTick < zonesEnd) ? end : -1;
+}
+
+// Heading after `ticks` rounds of determineAllRoutes on a train that stays
+// put. Each heading only depends on the one before, so the sequence repeats
+// within four rounds.
+static int headingAfter(SimulationContext &ctx, int trainID, int ticks) {
+    int seen[5];
+    seen[0] = ctx.trainDirection[trainID];
+    for (int n = 1; n <= ticks; n++) {
+        ctx.trainDirection[trainID] = seen[n - 1];
+        int next = getNextDirection(ctx, trainID, ctx.trainRow[trainID], ctx.trainColumn[trainID]);
+        for (int j = 0; j < n; j++) {
+            if (seen[j] == next) return seen[j + (ticks - j) % (n - j)];
+        }
+        seen[n] = next;
+    }
+    return seen[ticks];
+}
+
+// ----------------------------------------------------------------------------
+// QUIET TICKS AHEAD
+// ----------------------------------------------------------------------------
+// Count the ticks from now in which every active train is still waiting when
+// it is time to move. A halt is applied after the move, so a halt ending at
+// tick E holds a train through tick E. Returns 0 if a train may move (or
+// shares its tile and may crash), quiet_ticks_unbounded if none is active.
+// Spawns and pending switch work are left to the caller.
+// ----------------------------------------------------------------------------
+int quietTicksAhead(SimulationContext &ctx) {
+    int zonesEnd = haltZonesEnd(ctx);
+    int quiet = quiet_ticks_unbounded;
+
+    resetCollisionIndex(ctx);
+    for (int i = 0; i < ctx.numOf_trains; i++) {
+        ctx.plannedOnSegment[i] = 0;
+        if (ctx.trainRow[i] == -1) continue;
+        if (ctx.trainWait[i] <= 0) return 0;
+        if (isDestinationPoint(ctx, ctx.trainRow[i], ctx.trainColumn[i])) return 0;
+
+        indexOccupant(ctx, i);
+        if (ctx.plannedOnSegment[i] == -1) return 0;
+
+        int ticks = ctx.trainWait[i];
+        int haltEnd = haltOnTrain(ctx, i, zonesEnd);
+        if (haltEnd - ctx.currentTick + 1 > ticks) ticks = haltEnd - ctx.currentTick + 1;
+        if (ticks < quiet) quiet = ticks;
+    }
+    return quiet;
+}
+
+// ----------------------------------------------------------------------------
+// SKIP QUIET TICKS
+// ----------------------------------------------------------------------------
+// Apply `ticks` quiet ticks in one step: waits, wait time, headings and halt
+// zone expiry end up as if each tick had run. `ticks` must not exceed
+// quietTicksAhead().
+// ----------------------------------------------------------------------------
+void skipQuietTicks(SimulationContext &ctx, int ticks) {
+    if (ticks <= 0) return;
+    int zonesEnd = haltZonesEnd(ctx);
+    int lastTick = ctx.currentTick + ticks - 1;
+
+    for (int i = 0; i < ctx.numOf_trains; i++) {
+        if (ctx.trainRow[i] == -1) continue;
+
+        // The wait and an applied halt both count down one per tick
+        int wait = ctx.trainWait[i] - ticks;
+        int haltEnd = haltOnTrain(ctx, i, zonesEnd);
+        if (haltEnd != -1 && haltEnd - lastTick > wait) wait = haltEnd - lastTick;
+        ctx.trainWait[i] = wait;
+        ctx.totalWaitTicks += ticks;
+
+        ctx.trainDirection[i] = headingAfter(ctx, i, ticks);
+    }
+    updateSignalLights(ctx);
+
+    // Zone expiry only looks at the last tick
+    ctx.currentTick = lastTick;
+    updateEmergencyHalt(ctx);
+    ctx.currentTick = lastTick + 1;
+}
@@ -5,52 +5,68 @@
 // TRAINS.H - Train logic
 // ============================================================================
 
+struct SimulationContext;
+
 // ----------------------------------------------------------------------------
 // TRAIN SPAWNING
 // ----------------------------------------------------------------------------
 // Spawn trains scheduled for the current tick.
-void spawnTrainsForTick();
+void spawnTrainsForTick(SimulationContext &ctx);
 
 // ----------------------------------------------------------------------------
 // TRAIN ROUTING
 // ----------------------------------------------------------------------------
 // Compute routes for all trains (Phase 2).
-void determineAllRoutes();
+void determineAllRoutes(SimulationContext &ctx);
 
 // Compute next position/direction for a train.
-bool determineNextPosition(int trainID,int &nextRow, int &nextColumn);
+bool determineNextPosition(const SimulationContext &ctx, int trainID,int &nextRow, int &nextColumn);
 
 // Get next direction on entering a tile.
-int getNextDirection(int trainID,int row,int col);
+int getNextDirection(const SimulationContext &ctx, int trainID,int row,int col);
 
 // Choose best direction at a crossing.
-int getSmartDirectionAtCrossing(int trainID);
+int getSmartDirectionAtCrossing(const SimulationContext &ctx, int trainID);
 
 // ----------------------------------------------------------------------------
 // TRAIN MOVEMENT
 // ----------------------------------------------------------------------------
 // Move trains and handle collisions (Phase 5).
-void moveAllTrains();
+void moveAllTrains(SimulationContext &ctx);
 
 // ----------------------------------------------------------------------------
 // COLLISION DETECTION
 // ----------------------------------------------------------------------------
 // Detect trains targeting the same tile/swap/crossing.
-void detectCollisions(int nextRow[],int nextCol[],int nextDir[]);
+// Relies on the per-tile index that moveAllTrains builds while planning.
+void detectCollisions(SimulationContext &ctx, int nextRow[],int nextCol[],int nextDir[]);
 
 // ----------------------------------------------------------------------------
 // ARRIVALS
 // ----------------------------------------------------------------------------
 // Mark trains that reached destinations.
-void checkArrivals();
+void checkArrivals(SimulationContext &ctx);
 
 // ----------------------------------------------------------------------------
 // EMERGENCY HALT
 // ----------------------------------------------------------------------------
-// Apply emergency halt in active zone.
-void applyEmergencyHalt();
+// Start a 3x3 halt zone around row,col lasting `ticks` ticks.
+// Crashes trigger one automatically; returns false if off the grid.
+bool triggerEmergencyHalt(SimulationContext &ctx, int row, int col, int ticks);
+
+// Apply emergency halt in active zones.
+void applyEmergencyHalt(SimulationContext &ctx);
+
+// Expire finished zones (cost scales with active zones, not grid size).
+void updateEmergencyHalt(SimulationContext &ctx);
+
+// ----------------------------------------------------------------------------
+// QUIET TICKS
+// ----------------------------------------------------------------------------
+// Ticks from now in which every active train only waits (0 if one may move).
+int quietTicksAhead(SimulationContext &ctx);
 
-// Update emergency halt timer.
-void updateEmergencyHalt();
+// Apply that many quiet ticks at once, as if each had run.
+void skipQuietTicks(SimulationContext &ctx, int ticks);
 
 #endif
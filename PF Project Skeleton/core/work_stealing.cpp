@@ -0,0 +1,99 @@
+#include "work_stealing.h"
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// ============================================================================
+// WORK_STEALING.CPP - Parallel task runner
+// ============================================================================
+// Each worker owns a range of indices behind its own lock. The owner takes
+// one index at a time from the front; thieves take the back half, so a
+// range is only contended while it is being split. Ranges only shrink, so a
+// worker that finds every range empty can stop.
+// ============================================================================
+
+struct TaskRange {
+    mutex lock;
+    size_t begin;
+    size_t end;
+};
+
+// Take the next index from a worker's own range
+static bool takeOwn(TaskRange &range, size_t &index) {
+    lock_guard<mutex> guard(range.lock);
+    if (range.begin >= range.end) return false;
+    index = range.begin++;
+    return true;
+}
+
+// Move the back half of the largest other range into the thief's range
+static bool steal(vector<TaskRange> &ranges, int thief) {
+    for (;;) {
+        int victim = -1;
+        size_t largest = 0;
+        for (size_t v = 0; v < ranges.size(); v++) {
+            if ((int)v == thief) continue;
+            lock_guard<mutex> guard(ranges[v].lock);
+            size_t left = ranges[v].end - ranges[v].begin;
+            if (ranges[v].begin < ranges[v].end && left > largest) {
+                largest = left;
+                victim = (int)v;
+            }
+        }
+        if (victim == -1) return false;
+
+        size_t first, last;
+        {
+            lock_guard<mutex> guard(ranges[victim].lock);
+            if (ranges[victim].begin >= ranges[victim].end) continue;  // Emptied meanwhile
+            size_t left = ranges[victim].end - ranges[victim].begin;
+            last  = ranges[victim].end;
+            first = last - (left + 1) / 2;
+            ranges[victim].end = first;
+        }
+        lock_guard<mutex> guard(ranges[thief].lock);
+        ranges[thief].begin = first;
+        ranges[thief].end   = last;
+        return true;
+    }
+}
+
+static void workLoop(vector<TaskRange> &ranges, int worker,
+                     const function<void(size_t, int)> &task) {
+    for (;;) {
+        size_t index;
+        if (takeOwn(ranges[worker], index)) {
+            task(index, worker);
+            continue;
+        }
+        if (!steal(ranges, worker)) return;
+    }
+}
+
+int workStealingThreads(size_t count, int threads) {
+    if (threads <= 0) threads = (int)thread::hardware_concurrency();
+    if (threads <= 0) threads = 1;
+    if ((size_t)threads > count) threads = count > 0 ? (int)count : 1;
+    return threads;
+}
+
+int runWorkStealing(size_t count, int threads, const function<void(size_t, int)> &task) {
+    threads = workStealingThreads(count, threads);
+
+    // Equal blocks to start with
+    vector<TaskRange> ranges(threads);
+    for (int t = 0; t < threads; t++) {
+        ranges[t].begin = count * t / threads;
+        ranges[t].end   = count * (t + 1) / threads;
+    }
+
+    vector<thread> workers;
+    for (int t = 1; t < threads; t++) {
+        workers.push_back(thread(workLoop, ref(ranges), t, cref(task)));
+    }
+    workLoop(ranges, 0, task);                  // The caller works too
+    for (size_t t = 0; t < workers.size(); t++) workers[t].join();
+    return threads;
+}
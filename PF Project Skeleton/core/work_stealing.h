@@ -0,0 +1,26 @@
+#ifndef WORK_STEALING_H
+#define WORK_STEALING_H
+
+#include <cstddef>
+#include <functional>
+
+// ============================================================================
+// WORK_STEALING.H - Parallel task runner
+// ============================================================================
+// Runs a batch of independent tasks on a pool of threads. Every worker starts
+// with an equal block of task indices and works through it from the front;
+// a worker that runs dry steals the back half of the largest block left, so
+// runs of very different lengths still keep every thread busy.
+// ============================================================================
+
+// Call task(index, worker) once for every index in [0, count) using `threads`
+// workers (0 = one per hardware thread). `worker` is in [0, threads) and is
+// never used by two threads at once, so it can pick per-thread scratch state.
+// Returns the number of workers used.
+int runWorkStealing(size_t count, int threads,
+                    const std::function<void(size_t index, int worker)> &task);
+
+// Workers runWorkStealing would use for `count` tasks.
+int workStealingThreads(size_t count, int threads);
+
+#endif
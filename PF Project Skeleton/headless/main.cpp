@@ -0,0 +1,156 @@
+#include "../core/simulation_state.h"
+#include "../core/simulation.h"
+#include "../core/io.h"
+#include "../core/level_cache.h"
+#include "../core/snapshot.h"
+#include <cstdlib>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+// ============================================================================
+// HEADLESS/MAIN.CPP - Batch runner without SFML
+// ============================================================================
+// Loads a level and runs simulateOneTick() back to back, with no render loop
+// or tick throttle, until the simulation completes. Writes the usual CSV
+// traces (or binary ones with --binary-trace, written from a background
+// thread with --async-trace, switches/signals as changes only with
+// --delta-trace) and metrics.txt, and reports ticks/sec and wall time.
+// --level-cache DIR loads the level through the compiled level cache.
+// --event-step jumps over ticks where every train is waiting and no train is
+// due to spawn (advanceUntilNextEvent) instead of stepping tick by tick.
+// --checkpoint FILE --checkpoint-every N rewrites a snapshot of the run every
+// N ticks; --resume FILE continues from one instead of from tick 0.
+// ============================================================================
+
+// Write one tick's trace rows (`data` is the run's TraceLog)
+static void logTickTraces(const SimulationContext &ctx, void *data) {
+    TraceLog &log = *(TraceLog*)data;
+    logTrainTrace(log, ctx);
+    logSwitchState(log, ctx);
+    logSignalState(log, ctx);
+}
+
+static void printUsage() {
+    cout << "Usage: ./switchback_headless <level_file> [--no-trace] [--binary-trace] [--async-trace]"
+         << " [--delta-trace] [--level-cache DIR] [--event-step]"
+         << " [--checkpoint FILE] [--checkpoint-every N] [--resume FILE]\n"
+         << "  --no-trace            write metrics.txt only\n"
+         << "  --binary-trace        write trace.bin/switches.bin/signals.bin instead of CSV\n"
+         << "  --async-trace         format and write traces on a background thread\n"
+         << "  --delta-trace         log switches and signals as changes only\n"
+         << "  --level-cache DIR     load the level through the compiled level cache\n"
+         << "  --event-step          skip ticks in which nothing can change\n"
+         << "  --checkpoint FILE     rewrite a snapshot of the run to FILE\n"
+         << "  --checkpoint-every N  ticks between checkpoints (default 100)\n"
+         << "  --resume FILE         continue from a snapshot instead of tick 0\n";
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argv[1][0] == '-') {
+        printUsage();
+        return 1;
+    }
+
+    TraceLog log;
+    bool writeTraces = true;
+    bool binaryTraces = false;
+    bool asyncTraces = false;
+    bool eventStep = false;
+    const char *levelCache = 0;
+    const char *checkpointFile = 0;
+    int checkpointEvery = 100;
+    const char *resumeFile = 0;
+    for (int i = 2; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--no-trace") == 0) writeTraces = false;
+        else if (strcmp(argv[i], "--binary-trace") == 0) binaryTraces = true;
+        else if (strcmp(argv[i], "--async-trace") == 0) asyncTraces = true;
+        else if (strcmp(argv[i], "--delta-trace") == 0) setDeltaLogging(log, log_keyframe_ticks);
+        else if (strcmp(argv[i], "--event-step") == 0) eventStep = true;
+        else if (strcmp(argv[i], "--level-cache") == 0 && hasValue) levelCache = argv[++i];
+        else if (strcmp(argv[i], "--checkpoint") == 0 && hasValue) checkpointFile = argv[++i];
+        else if (strcmp(argv[i], "--checkpoint-every") == 0 && hasValue) checkpointEvery = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--resume") == 0 && hasValue) resumeFile = argv[++i];
+        else {
+            cout << "Error: Unknown or incomplete option " << argv[i] << endl;
+            printUsage();
+            return 1;
+        }
+    }
+
+    // initialize simulation core
+    SimulationContext ctx;
+    initializeSimulation(ctx);
+
+    bool loaded = levelCache ? loadLevelCached(ctx, argv[1], levelCache)
+                             : loadLevelFile(ctx, argv[1]);
+    if (!loaded) {
+        cout << "Error: Failed to load level file: " << argv[1] << endl;
+        return 1;
+    }
+
+    // Pick up a checkpointed run where it stopped
+    if (resumeFile) {
+        vector<char> snapshot;
+        if (!readSnapshotFile(resumeFile, snapshot) ||
+            !restoreSnapshot(ctx, snapshot.data(), snapshot.size())) {
+            cout << "Error: Cannot resume from " << resumeFile << " with this level" << endl;
+            return 1;
+        }
+        cout << "Resumed at tick " << ctx.currentTick << "." << endl;
+    }
+    if (checkpointEvery < 1) checkpointEvery = 1;
+    int startTick = ctx.currentTick;
+    int lastCheckpoint = ctx.currentTick;
+    vector<char> checkpoint;
+
+    if (writeTraces && binaryTraces) initializeBinaryLogFiles(log, ctx);
+    else if (writeTraces) initializeLogFiles(log);
+    if (writeTraces && asyncTraces) startAsyncLogging(log);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    // Step at full speed until all trains are delivered or crashed
+    while (true) {
+        if (eventStep) {
+            advanceUntilNextEvent(ctx, writeTraces ? logTickTraces : 0, &log);
+        } else {
+            simulateOneTick(ctx);
+            if (writeTraces) logTickTraces(ctx, &log);
+        }
+
+        if (isSimulationComplete(ctx)) break;
+
+        if (checkpointFile && ctx.currentTick - lastCheckpoint >= checkpointEvery) {
+            takeSnapshot(ctx, checkpoint);
+            if (!writeSnapshotFile(checkpoint, checkpointFile)) {
+                cout << "Warning: Cannot write checkpoint " << checkpointFile << endl;
+            }
+            lastCheckpoint = ctx.currentTick;
+        }
+    }
+
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    double wallSeconds = chrono::duration<double>(end - start).count();
+    double ticksPerSecond = (wallSeconds > 0.0) ? (ctx.currentTick - startTick) / wallSeconds : 0.0;
+
+    writeMetrics(log, ctx);
+
+    // Performance report goes next to the simulation metrics
+    ofstream file("metrics.txt", ios::app);
+    if (file.is_open()) {
+        file << "Wall Time (ms): " << wallSeconds * 1000.0 << endl;
+        file << "Ticks Per Second: " << ticksPerSecond << endl;
+        file.close();
+    }
+
+    cout << "Simulation Finished in " << ctx.currentTick << " ticks." << endl;
+    cout << "Wall Time (ms): " << wallSeconds * 1000.0 << endl;
+    cout << "Ticks Per Second: " << ticksPerSecond << endl;
+    return 0;
+}
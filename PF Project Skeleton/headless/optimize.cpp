@@ -0,0 +1,93 @@
+#include "../core/simulation_state.h"
+#include "../core/optimizer.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+// ============================================================================
+// HEADLESS/OPTIMIZE.CPP - Level tuning runner
+// ============================================================================
+// Searches a level's switch K values and spawn ticks with optimizeLevel and
+// writes the best tuning found as a new .lvl, leaving the rest of the file
+// untouched. Progress is printed each time a round finds a better tuning.
+// ============================================================================
+
+static void printUsage() {
+    cout << "Usage: ./switchback_optimize <level_file> [--out FILE] [--generations N]"
+         << " [--candidates N] [--max-k K] [--max-shift T] [--seed N] [--threads N]\n"
+         << "  --out FILE        tuned level (default: <level>_optimized.lvl)\n"
+         << "  --generations N   search rounds (default 40)\n"
+         << "  --candidates N    tunings simulated per round (default 32)\n"
+         << "  --max-k K         switch K values tried, 1..K (default " << switch_max_K << ")\n"
+         << "  --max-shift T     spawn ticks move at most T ticks (default 8, 0 = fixed)\n"
+         << "  --seed N          search seed (default 1)\n"
+         << "  --threads N       worker threads (default: one per hardware thread)\n";
+}
+
+static void printScore(const char *label, const TuningScore &score) {
+    cout << label << "delivered " << score.delivered << ", crashed " << score.crashed
+         << ", wait ticks " << score.waitTicks << ", ticks " << score.completionTick << endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argv[1][0] == '-') {
+        printUsage();
+        return 1;
+    }
+    string level = argv[1];
+    string outPath;
+    OptimizerOptions options;
+    for (int i = 2; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--out") == 0 && hasValue) outPath = argv[++i];
+        else if (strcmp(argv[i], "--generations") == 0 && hasValue) options.generations = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--candidates") == 0 && hasValue) options.candidates = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--max-k") == 0 && hasValue) options.maxK = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--max-shift") == 0 && hasValue) options.maxSpawnShift = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && hasValue) options.seed = (unsigned int)strtoul(argv[++i], 0, 10);
+        else if (strcmp(argv[i], "--threads") == 0 && hasValue) options.threads = atoi(argv[++i]);
+        else {
+            printUsage();
+            return 1;
+        }
+    }
+    if (outPath.empty()) {
+        string stem = level;
+        if (stem.size() > 4 && stem.compare(stem.size() - 4, 4, ".lvl") == 0) stem.erase(stem.size() - 4);
+        outPath = stem + "_optimized.lvl";
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    OptimizerResult result;
+    LevelLoadError error;
+    if (!optimizeLevel(level, options, result, &error)) {
+        cout << "Error: " << error.file;
+        if (error.line > 0) cout << ":" << error.line;
+        cout << ": " << error.message << endl;
+        return 1;
+    }
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    double wallSeconds = chrono::duration<double>(end - start).count();
+
+    cout << "Level: " << level << endl;
+    printScore("Original:  ", result.originalScore);
+    for (size_t i = 0; i < result.improvedAt.size(); i++) {
+        cout << "Round " << result.improvedAt[i] + 1 << ": ";
+        printScore("", result.improvements[i]);
+    }
+    printScore("Optimized: ", result.bestScore);
+    cout << "Candidates: " << result.evaluated << " (" << result.stoppedEarly
+         << " stopped early)" << endl;
+    cout << "Wall Time (ms): " << wallSeconds * 1000.0 << endl;
+
+    if (!writeTunedLevel(level, outPath, result.best)) {
+        cout << "Error: Could not write " << outPath << endl;
+        return 1;
+    }
+    cout << "Wrote " << outPath << endl;
+    return 0;
+}
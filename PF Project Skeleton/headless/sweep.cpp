@@ -0,0 +1,176 @@
+#include "../core/simulation_state.h"
+#include "../core/simulation.h"
+#include "../core/sweep.h"
+#include "../core/work_stealing.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// ============================================================================
+// HEADLESS/SWEEP.CPP - Monte Carlo sweep runner
+// ============================================================================
+// Runs one level once per seed and weather on every core and reports the
+// spread of the metrics.txt figures (delivered, crashed, waiting time and
+// completion tick) per weather, so a network can be judged across seeds
+// rather than on the single SEED in its .lvl file. --csv writes every run.
+// ============================================================================
+
+static const char *weatherNames[weather_types] = { "NORMAL", "RAIN", "FOG" };
+
+static void printUsage() {
+    cout << "Usage: ./switchback_sweep <level_file> [--seeds FIRST-LAST] [--weather LIST]"
+         << " [--threads N] [--csv FILE]\n"
+         << "  --seeds FIRST-LAST  seed range, inclusive (default 1-1000)\n"
+         << "  --weather LIST      comma list of NORMAL, RAIN, FOG (default: the level's)\n"
+         << "  --threads N         worker threads (default: one per hardware thread)\n"
+         << "  --csv FILE          write one row per run to FILE\n";
+}
+
+static bool parseSeeds(const char *text, unsigned int &first, unsigned int &last) {
+    char *end = 0;
+    unsigned long a = strtoul(text, &end, 10);
+    if (end == text) return false;
+    unsigned long b = a;
+    if (*end == '-') {
+        const char *second = end + 1;
+        b = strtoul(second, &end, 10);
+        if (end == second) return false;
+    }
+    if (*end != '\0' || b < a) return false;
+    first = (unsigned int)a;
+    last  = (unsigned int)b;
+    return true;
+}
+
+static bool parseWeather(const string &list, vector<int> &weathers) {
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t comma = list.find(',', start);
+        string name = list.substr(start, comma == string::npos ? string::npos : comma - start);
+        int found = -1;
+        for (int w = 0; w < weather_types; w++) {
+            if (name == weatherNames[w]) found = w;
+        }
+        if (found == -1) return false;
+        weathers.push_back(found);
+        if (comma == string::npos) break;
+        start = comma + 1;
+    }
+    return !weathers.empty();
+}
+
+static void printDistribution(const char *name, const SweepDistribution &d) {
+    printf("  %-16s %9.2f %9.2f %7d %7d %7d %7d %7d\n", name, d.mean, d.stddev,
+           d.min, d.p50, d.p90, d.p99, d.max);
+}
+
+// Distributions of the runs under one weather (-1 = all runs)
+static void printSummary(const vector<SweepRun> &runs, int weather) {
+    vector<int> delivered, crashed, waitTicks, completion;
+    for (size_t i = 0; i < runs.size(); i++) {
+        if (!runs[i].finished || (weather != -1 && runs[i].weather != weather)) continue;
+        delivered.push_back(runs[i].delivered);
+        crashed.push_back(runs[i].crashed);
+        waitTicks.push_back(runs[i].waitTicks);
+        completion.push_back(runs[i].completionTick);
+    }
+    if (delivered.empty()) return;
+
+    cout << endl << (weather == -1 ? "ALL" : weatherNames[weather])
+         << " (" << delivered.size() << " runs)" << endl;
+    printf("  %-16s %9s %9s %7s %7s %7s %7s %7s\n", "metric", "mean", "stddev",
+           "min", "p50", "p90", "p99", "max");
+    printDistribution("delivered", summarizeSweep(delivered));
+    printDistribution("crashed", summarizeSweep(crashed));
+    printDistribution("wait ticks", summarizeSweep(waitTicks));
+    printDistribution("completion tick", summarizeSweep(completion));
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argv[1][0] == '-') {
+        printUsage();
+        return 1;
+    }
+    string level = argv[1];
+    unsigned int firstSeed = 1, lastSeed = 1000;
+    vector<int> weathers;
+    int threads = 0;
+    const char *csvPath = 0;
+    for (int i = 2; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--seeds") == 0 && hasValue) {
+            if (!parseSeeds(argv[++i], firstSeed, lastSeed)) {
+                cout << "Error: Bad seed range: " << argv[i] << endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--weather") == 0 && hasValue) {
+            if (!parseWeather(argv[++i], weathers)) {
+                cout << "Error: Bad weather list: " << argv[i] << endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--threads") == 0 && hasValue) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--csv") == 0 && hasValue) {
+            csvPath = argv[++i];
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+
+    // Load once up front to report errors and pick up the level's weather
+    SimulationContext ctx;
+    initializeSimulation(ctx);
+    LevelLoadError error;
+    if (!loadLevelFile(ctx, level, &error)) {
+        cout << "Error: " << error.file;
+        if (error.line > 0) cout << ":" << error.line;
+        cout << ": " << error.message << endl;
+        return 1;
+    }
+    if (weathers.empty()) weathers.push_back(ctx.weather_type);
+
+    vector<SweepRun> runs;
+    planSweep(firstSeed, lastSeed, weathers, runs);
+    int workers = workStealingThreads(runs.size(), threads);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    size_t finished = runSweep(level, runs, workers, &error);
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    double wallSeconds = chrono::duration<double>(end - start).count();
+
+    cout << "Level: " << level << endl;
+    cout << "Runs: " << finished << " of " << runs.size() << " (seeds " << firstSeed << "-"
+         << lastSeed << " x " << weathers.size() << " weather), threads: " << workers << endl;
+    cout << "Wall Time (ms): " << wallSeconds * 1000.0 << endl;
+    cout << "Runs Per Second: " << (wallSeconds > 0.0 ? finished / wallSeconds : 0.0) << endl;
+    if (finished < runs.size()) {
+        cout << "Error: " << error.file << ": " << error.message << endl;
+    }
+
+    for (size_t w = 0; w < weathers.size(); w++) printSummary(runs, weathers[w]);
+    if (weathers.size() > 1) printSummary(runs, -1);
+
+    if (csvPath) {
+        ofstream csv(csvPath);
+        if (!csv.is_open()) {
+            cout << "Error: Could not write " << csvPath << endl;
+            return 1;
+        }
+        csv << "seed,weather,delivered,crashed,wait_ticks,completion_tick" << endl;
+        for (size_t i = 0; i < runs.size(); i++) {
+            if (!runs[i].finished) continue;
+            csv << runs[i].seed << "," << weatherNames[runs[i].weather] << ","
+                << runs[i].delivered << "," << runs[i].crashed << ","
+                << runs[i].waitTicks << "," << runs[i].completionTick << endl;
+        }
+    }
+    return finished == runs.size() ? 0 : 2;
+}
@@ -0,0 +1,118 @@
+#include "../core/simulation_state.h"
+#include "../core/simulation.h"
+#include "../core/io.h"
+#include "../core/fork.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// ============================================================================
+// HEADLESS/WHATIF.CPP - What-if runner
+// ============================================================================
+// Runs a level to a tick, then forks it once per question: left as is, each
+// switch toggled, and each requested safety tile toggled. Every fork runs
+// the same number of ticks on its own thread (runWhatIf) and the outcomes
+// are printed next to the untouched branch.
+// ============================================================================
+
+static void printUsage() {
+    cout << "Usage: ./switchback_whatif <level_file> [--at T] [--ticks N] [--switches LIST]"
+         << " [--safety R,C] [--threads N]\n"
+         << "  --at T          tick to fork at (default 0)\n"
+         << "  --ticks N       ticks each branch runs (default 50)\n"
+         << "  --switches LIST switch letters to try toggling, e.g. ACF (default: all)\n"
+         << "  --safety R,C    also try toggling the safety tile at row R, column C\n"
+         << "                  (repeatable)\n"
+         << "  --threads N     worker threads (default: one per hardware thread)\n";
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argv[1][0] == '-') {
+        printUsage();
+        return 1;
+    }
+    string level = argv[1];
+    int forkTick = 0;
+    int ticks = 50;
+    int threads = 0;
+    const char *switchList = 0;
+    vector<pair<int, int> > safetyTiles;
+    for (int i = 2; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        int row, col;
+        if (strcmp(argv[i], "--at") == 0 && hasValue) forkTick = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--ticks") == 0 && hasValue) ticks = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--switches") == 0 && hasValue) switchList = argv[++i];
+        else if (strcmp(argv[i], "--threads") == 0 && hasValue) threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--safety") == 0 && hasValue &&
+                 sscanf(argv[++i], "%d,%d", &row, &col) == 2) {
+            safetyTiles.push_back(make_pair(row, col));
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+
+    SimulationContext ctx;
+    initializeSimulation(ctx);
+    LevelLoadError error;
+    if (!loadLevelFile(ctx, level, &error)) {
+        cout << "Error: " << error.file;
+        if (error.line > 0) cout << ":" << error.line;
+        cout << ": " << error.message << endl;
+        return 1;
+    }
+    while (ctx.currentTick < forkTick && !isSimulationComplete(ctx)) simulateOneTick(ctx);
+
+    // Branch 0 is left as is; the rest each make one edit
+    vector<WhatIfBranch> branches(1);
+    vector<string> labels(1, "as is");
+    for (int s = 0; s < ctx.numSwitches; s++) {
+        if (switchList && !strchr(switchList, ctx.switchLetter[s])) continue;
+        branches.push_back(WhatIfBranch());
+        branches.back().switchToggles.push_back(s);
+        labels.push_back(string("switch ") + ctx.switchLetter[s]);
+    }
+    for (size_t t = 0; t < safetyTiles.size(); t++) {
+        branches.push_back(WhatIfBranch());
+        branches.back().safetyToggles.push_back(safetyTiles[t]);
+        labels.push_back("safety " + to_string((long long)safetyTiles[t].first) + "," +
+                         to_string((long long)safetyTiles[t].second));
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    runWhatIf(ctx, branches, ticks, threads);
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    double wallSeconds = chrono::duration<double>(end - start).count();
+
+    const WhatIfBranch &base = branches[0];
+    cout << "Level: " << level << endl;
+    cout << "Forked at tick " << ctx.currentTick << ", " << ticks << " ticks per branch" << endl;
+    cout << left << setw(16) << "branch" << right << setw(10) << "delivered" << setw(9)
+         << "crashed" << setw(12) << "wait ticks" << setw(8) << "tick" << endl;
+    for (size_t b = 0; b < branches.size(); b++) {
+        const WhatIfBranch &branch = branches[b];
+        cout << left << setw(16) << labels[b] << right;
+        if (!branch.finished) {
+            cout << "   (edit refused)" << endl;
+            continue;
+        }
+        cout << setw(10) << branch.delivered << setw(9) << branch.crashed << setw(12)
+             << branch.waitTicks << setw(8) << branch.endTick;
+        if (b > 0 && base.finished) {
+            cout << "   " << showpos << branch.delivered - base.delivered << " delivered, "
+                 << branch.crashed - base.crashed << " crashed, "
+                 << branch.waitTicks - base.waitTicks << " wait" << noshowpos;
+        }
+        cout << endl;
+    }
+    cout << "Wall Time (ms): " << wallSeconds * 1000.0 << endl;
+    return 0;
+}
@@ -22,14 +22,19 @@ static float g_cellSize = 24.0f;        // world units per grid cell
 static float g_gridOffsetX = 8.0f;      // margin from left
 static float g_gridOffsetY = 8.0f;      // margin from top
 static sf::Font g_font;
+static SimulationContext* g_sim = nullptr;   // simulation shown in the window
+static TraceLog* g_log = nullptr;            // its trace log
 
 // ----------------------------------------------------------------------------
 // INITIALIZATION
 // ----------------------------------------------------------------------------
-bool initializeApp() {
+bool initializeApp(SimulationContext &ctx, TraceLog &log) {
+    g_sim = &ctx;
+    g_log = &log;
+
     // Variable Name Fix: numColumns -> number_column, numRows -> number_rows
-    int cols = (number_column > 0) ? number_column : 40;
-    int rows = (number_rows > 0) ? number_rows : 25;
+    int cols = (ctx.number_column > 0) ? ctx.number_column : 40;
+    int rows = (ctx.number_rows > 0) ? ctx.number_rows : 25;
     
     int width = (int)(cols * g_cellSize + g_gridOffsetX * 2);
     int height = (int)(rows * g_cellSize + g_gridOffsetY * 2);
@@ -54,23 +59,18 @@ bool initializeApp() {
         return false;
     }
     
-    // Initialize originalGrid for toggle functionality
-    for (int r = 0; r < number_rows; r++) {
-        for (int c = 0; c < number_column; c++) {
-            originalGrid[r][c] = grid[r][c];
-        }
-    }
-    
+    // originalGrid is filled by loadLevelFile for toggle functionality
     return true;   
 }
 static void drawMetrics(sf::RenderWindow &win) {
+    const SimulationContext &ctx = *g_sim;
     sf::Text text;
     text.setFont(g_font);
     text.setCharacterSize(20);
     text.setFillColor(sf::Color::Green);
 
     std::string weatherStr;
-    switch(weather_type) {
+    switch(ctx.weather_type) {
         case 0: weatherStr = "Normal"; break;
         case 1: weatherStr = "Rain"; break;
         case 2: weatherStr = "Fog"; break;
@@ -82,10 +82,10 @@ static void drawMetrics(sf::RenderWindow &win) {
     std::string metricsStr;
     metricsStr += "Switchback Rails\n";
     metricsStr += "Status: " + statusStr + "\n";
-    metricsStr += "Tick: " + std::to_string(currentTick) + "\n";
-    metricsStr += "Active Trains: " + std::to_string(numOf_trains) + "\n";
-    metricsStr += "Delivered Trains: " + std::to_string(trainsReached) + "\n";
-    metricsStr += "Crashed Trains: " + std::to_string(crashed_trains) + "\n";
+    metricsStr += "Tick: " + std::to_string(ctx.currentTick) + "\n";
+    metricsStr += "Active Trains: " + std::to_string(ctx.numOf_trains) + "\n";
+    metricsStr += "Delivered Trains: " + std::to_string(ctx.trainsReached) + "\n";
+    metricsStr += "Crashed Trains: " + std::to_string(ctx.crashed_trains) + "\n";
     metricsStr += "Weather: " + weatherStr + "\n";
 
     text.setString(metricsStr);
@@ -100,6 +100,7 @@ static void drawMetrics(sf::RenderWindow &win) {
 // HELPER: DRAW TILE
 // ----------------------------------------------------------------------------
 static void drawTile(sf::RenderWindow &win, int r, int c, char ch) {
+    const SimulationContext &ctx = *g_sim;
     sf::RectangleShape rect(sf::Vector2f(g_cellSize - 1.0f, g_cellSize - 1.0f));
     rect.setPosition(g_gridOffsetX + c * g_cellSize, g_gridOffsetY + r * g_cellSize);
 
@@ -128,7 +129,7 @@ static void drawTile(sf::RenderWindow &win, int r, int c, char ch) {
         win.draw(inner);
         
         // BONUS: Add Signal Light on top of switch if needed
-        int sIdx = getSwitchIndex(r, c);
+        int sIdx = getSwitchIndex(ctx, r, c);
         if (sIdx != -1) {
             float cx = g_gridOffsetX + c * g_cellSize + g_cellSize * 0.5f;
             float cy = g_gridOffsetY + r * g_cellSize + g_cellSize * 0.5f;
@@ -137,8 +138,8 @@ static void drawTile(sf::RenderWindow &win, int r, int c, char ch) {
             signal.setOrigin(radius, radius);
             signal.setPosition(cx, cy);
             // 0=Green, 1=Yellow, 2=Red
-            if (switchSignal[sIdx] == 0) signal.setFillColor(sf::Color::Green);
-            else if (switchSignal[sIdx] == 1) signal.setFillColor(sf::Color::Yellow);
+            if (ctx.switchSignal[sIdx] == 0) signal.setFillColor(sf::Color::Green);
+            else if (ctx.switchSignal[sIdx] == 1) signal.setFillColor(sf::Color::Yellow);
             else signal.setFillColor(sf::Color::Red);
             win.draw(signal);
         }
@@ -177,6 +178,7 @@ static void drawTrain(sf::RenderWindow &win, int r, int c, int colorIdx) {
 // HELPER: CONVERT WORLD MOUSE POS TO GRID COORDS
 // ----------------------------------------------------------------------------
 static bool worldToGrid(const sf::RenderWindow &win, sf::Vector2i pix, int &outR, int &outC) {
+    const SimulationContext &ctx = *g_sim;
     sf::Vector2f world = win.mapPixelToCoords(pix);
     float wx = world.x - g_gridOffsetX;
     float wy = world.y - g_gridOffsetY;
@@ -187,7 +189,7 @@ static bool worldToGrid(const sf::RenderWindow &win, sf::Vector2i pix, int &outR
     int r = (int)(wy / g_cellSize);
     
     // Variable Name Fix: numRows -> number_rows, numColumns -> number_column
-    if (r < 0 || r >= number_rows || c < 0 || c >= number_column) return false;
+    if (r < 0 || r >= ctx.number_rows || c < 0 || c >= ctx.number_column) return false;
     
     outR = r; outC = c;
     return true;
@@ -197,7 +199,9 @@ static bool worldToGrid(const sf::RenderWindow &win, sf::Vector2i pix, int &outR
 // MAIN APP LOOP
 // ----------------------------------------------------------------------------
 void runApp() {
-    if (!g_window) return;
+    if (!g_window || !g_sim || !g_log) return;
+    SimulationContext &ctx = *g_sim;
+    TraceLog &log = *g_log;
 
     const int TICKS_PER_SEC = 4;
     const int MS_PER_TICK = 1000 / TICKS_PER_SEC;
@@ -212,7 +216,7 @@ void runApp() {
         sf::Event event;
         while (g_window->pollEvent(event)) {
             if (event.type == sf::Event::Closed) {
-                writeMetrics();
+                writeMetrics(log, ctx);
                 g_window->close();
                 break;
             }
@@ -220,7 +224,7 @@ void runApp() {
             // Keyboard
             if (event.type == sf::Event::KeyPressed) {
                 if (event.key.code == sf::Keyboard::Escape) {
-                    writeMetrics();
+                    writeMetrics(log, ctx);
                     g_window->close();
                     break;
                 }
@@ -245,14 +249,14 @@ void runApp() {
                     if (worldToGrid(*g_window, mp, gr, gc)) {
                         // Left Click: Safety Tile
                         if (event.mouseButton.button == sf::Mouse::Left) {
-                            toggleSafetyTile(gr, gc);
+                            toggleSafetyTile(ctx, gr, gc);
                         } 
                         // Right Click: Toggle Switch
                         else if (event.mouseButton.button == sf::Mouse::Right) {
-                            int sidx = getSwitchIndex(gr, gc);
+                            int sidx = getSwitchIndex(ctx, gr, gc);
                             // Variable Name Fix: maximum_switches
                             if (sidx >= 0 && sidx < maximum_switches) {
-                                switchState[sidx] = 1 - switchState[sidx]; // Toggle
+                                ctx.switchState[sidx] = 1 - ctx.switchState[sidx]; // Toggle
                                 cout << "Switch toggled manually." << endl;
                             }
                         }
@@ -295,15 +299,15 @@ void runApp() {
         while (accumulator >= MS_PER_TICK) {
             if (!g_isPaused || g_stepOnce) {
                 // Variable Name Fix: updateSimulation() -> simulateOneTick()
-                simulateOneTick(); 
+                simulateOneTick(ctx); 
                 
                 // Logging
-                logTrainTrace();
-                logSwitchState();
-                logSignalState();
+                logTrainTrace(log, ctx);
+                logSwitchState(log, ctx);
+                logSignalState(log, ctx);
                 
                 // Check if simulation is complete (all trains arrived or crashed)
-                if (isSimulationComplete()) {
+                if (isSimulationComplete(ctx)) {
                     g_isPaused = true;
                     cout << "Simulation complete! All trains have arrived or crashed.\n";
                 }
@@ -319,30 +323,30 @@ void runApp() {
 
         // A. Draw Grid
         // Variable Name Fix: number_rows, number_column
-        for (int r = 0; r < number_rows; r++) {
-            for (int c = 0; c < number_column; c++) {
-                drawTile(*g_window, r, c, grid[r][c]);
+        for (int r = 0; r < ctx.number_rows; r++) {
+            for (int c = 0; c < ctx.number_column; c++) {
+                drawTile(*g_window, r, c, ctx.grid[r][c]);
             }
         }
 
         // B. Draw Active Trains
         // Variable Name Fix: numOf_trains, trainRow, trainColumn
-        for (int i = 0; i < numOf_trains; i++) {
-            if (trainRow[i] >= 0 && trainColumn[i] >= 0) {
+        for (int i = 0; i < ctx.numOf_trains; i++) {
+            if (ctx.trainRow[i] >= 0 && ctx.trainColumn[i] >= 0) {
                 // Use i % 8 for color if trainColor not reliable, or use trainColor[i]
-                int colorIdx = (i >= 0 && i < max_trains) ? (i % 8) : 0;
-                drawTrain(*g_window, trainRow[i], trainColumn[i], colorIdx);
+                int colorIdx = (i >= 0 && i < ctx.trainCapacity) ? (i % 8) : 0;
+                drawTrain(*g_window, ctx.trainRow[i], ctx.trainColumn[i], colorIdx);
             }
         }
         
         // C. Draw Scheduled/Spawn Points
         // Variable Name Fix: num_spawn, spawnn_Row, spawnn_Column
-        for (int i = 0; i < num_spawn; i++) {
+        for (int i = 0; i < ctx.num_spawn; i++) {
             // Only draw if NOT spawned yet (index >= numOf_trains logic used in your snippet)
-            if (i >= numOf_trains) {
-                int sr = spawnn_Row[i], sc = spawnn_Column[i];
+            if (i >= ctx.numOf_trains) {
+                int sr = ctx.spawnn_Row[i], sc = ctx.spawnn_Column[i];
                 if (sr >= 0 && sc >= 0) {
-                    drawTrain(*g_window, sr, sc, spawnColor[i]);
+                    drawTrain(*g_window, sr, sc, ctx.spawnColor[i]);
                 }
             }
         }
@@ -360,4 +364,5 @@ void cleanupApp() {
         delete g_window;
         g_window = nullptr;
     }
+    g_sim = nullptr;
 }
\ No newline at end of file
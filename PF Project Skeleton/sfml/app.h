@@ -7,12 +7,15 @@
 // This module uses only functions and global variables for the SFML frontend.
 // ============================================================================
 
+struct SimulationContext;
+struct TraceLog;
+
 // ----------------------------------------------------------------------------
 // INITIALIZATION
 // ----------------------------------------------------------------------------
-// Initialize the SFML window and resources
-// Returns true on success, false on failure
-bool initializeApp();
+// Initialize the SFML window and resources for a loaded simulation, tracing
+// into `log`. Returns true on success, false on failure
+bool initializeApp(SimulationContext &ctx, TraceLog &log);
 
 // ----------------------------------------------------------------------------
 // MAIN RUN LOOP
@@ -14,19 +14,22 @@ int main(int argc, char* argv[]) {
     }
 
     // initialize simulation core
-    initializeSimulation();
+    SimulationContext ctx;
+    initializeSimulation(ctx);
 
-    if (!loadLevelFile(argv[1])) {
+    if (!loadLevelFile(ctx, argv[1])) {
         cout << "Error: Failed to load level file: " << argv[1] << endl;
         return 1;
     }
 
-    initializeLogFiles();
+    TraceLog log;
+    initializeLogFiles(log);
+    startAsyncLogging(log);    //Keep trace writes out of the frame loop
 
     cout << "Level Loaded: " << argv[1] << endl;
     cout << "Starting Graphics..." << endl;
 
-    if (!initializeApp()) {
+    if (!initializeApp(ctx, log)) {
         cout << "Failed to initialize graphics app" << endl;
         return 1;
     }
@@ -34,7 +37,7 @@ int main(int argc, char* argv[]) {
     runApp();
     cleanupApp();
 
-    writeMetrics();
+    writeMetrics(log, ctx);
     cout << "Simulation Finished. Metrics saved." << endl;
     return 0;
 }
\ No newline at end of file
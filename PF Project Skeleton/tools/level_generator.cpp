@@ -0,0 +1,296 @@
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// ============================================================================
+// TOOLS/LEVEL_GENERATOR.CPP - Synthetic level generator
+// ============================================================================
+// Writes .lvl files in the usual ROWS/COLS/SEED/WEATHER/MAP/SWITCHES/TRAINS
+// format for scaling and stress runs. The network is a ladder/mesh:
+//
+//   S-------+--------+-------D     horizontal rails every --rail-spacing rows,
+//           |        |             rungs every --rung-spacing columns,
+//   S-------A -------+-------D     each rung segment built with --crossings
+//           |        |             probability ('+' where it meets a rail),
+//   S-------+--------+-------D     switches at rung junctions.
+//
+// Every rail starts at an S and ends at a D. Trains spawn in batches of one
+// per rail every --spawn-every ticks, each batch on a shuffled rail order so
+// most trains have to change rails to reach their destination. The same
+// options and --seed always produce the same file.
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// OPTIONS
+// ----------------------------------------------------------------------------
+// Switch letters: A-Z except S and D. Each switch gets its own letter, since
+// tiles sharing a letter would share one state and one set of counters.
+static const char switchLetters[] = "ABCEFGHIJKLMNOPQRTUVWXYZ";
+static const int max_switches = (int)sizeof(switchLetters) - 1;
+
+struct GeneratorOptions {
+    int rows;
+    int columns;
+    int railSpacing;
+    int rungSpacing;
+    double crossings;
+    int switches;
+    int k[4];
+    bool globalSwitches;
+    double safety;
+    int trains;
+    int spawnEvery;
+    unsigned int seed;
+    string weather;
+    string output;
+};
+
+static void printUsage() {
+    cout << "Usage: ./switchback_levelgen [options]\n"
+         << "  --rows N            grid rows (default 60)\n"
+         << "  --cols N            grid columns (default 120)\n"
+         << "  --rail-spacing N    rows between horizontal rails (default 3)\n"
+         << "  --rung-spacing N    columns between vertical rungs (default 8)\n"
+         << "  --crossings P       chance a rung segment is built, 0..1 (default 1)\n"
+         << "  --switches N        switch tiles placed at rung junctions, at most 24\n"
+         << "                      (default 20)\n"
+         << "  --k K[,K,K,K]       switch K values per direction (default 3)\n"
+         << "  --global            switches use GLOBAL mode instead of PER_DIR\n"
+         << "  --safety P          chance a rail tile is a safety tile '=' (default 0)\n"
+         << "  --trains N          number of trains (default 40)\n"
+         << "  --spawn-every T     ticks between spawn batches (default 4)\n"
+         << "  --seed N            generator and level seed (default 1)\n"
+         << "  --weather W         NORMAL, RAIN or FOG (default NORMAL)\n"
+         << "  --out FILE          output file (default: stdout)\n";
+}
+
+static bool parseK(const string &text, int k[4]) {
+    stringstream in(text);
+    string part;
+    int count = 0;
+    while (getline(in, part, ',') && count < 4) {
+        k[count++] = atoi(part.c_str());
+    }
+    if (count == 1) k[1] = k[2] = k[3] = k[0];
+    else if (count != 4) return false;
+    for (int i = 0; i < 4; i++) {
+        if (k[i] < 1) return false;
+    }
+    return true;
+}
+
+static bool parseOptions(int argc, char* argv[], GeneratorOptions &opt) {
+    opt.rows = 60;
+    opt.columns = 120;
+    opt.railSpacing = 3;
+    opt.rungSpacing = 8;
+    opt.crossings = 1.0;
+    opt.switches = 20;
+    opt.k[0] = opt.k[1] = opt.k[2] = opt.k[3] = 3;
+    opt.globalSwitches = false;
+    opt.safety = 0.0;
+    opt.trains = 40;
+    opt.spawnEvery = 4;
+    opt.seed = 1;
+    opt.weather = "NORMAL";
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--global") { opt.globalSwitches = true; continue; }
+        if (arg == "--help") return false;
+        if (i + 1 >= argc) {
+            cout << "Error: Missing value for " << arg << endl;
+            return false;
+        }
+        string value = argv[++i];
+        if (arg == "--rows") opt.rows = atoi(value.c_str());
+        else if (arg == "--cols") opt.columns = atoi(value.c_str());
+        else if (arg == "--rail-spacing") opt.railSpacing = atoi(value.c_str());
+        else if (arg == "--rung-spacing") opt.rungSpacing = atoi(value.c_str());
+        else if (arg == "--crossings") opt.crossings = atof(value.c_str());
+        else if (arg == "--switches") opt.switches = atoi(value.c_str());
+        else if (arg == "--k") {
+            if (!parseK(value, opt.k)) {
+                cout << "Error: --k expects 1 or 4 positive values" << endl;
+                return false;
+            }
+        }
+        else if (arg == "--safety") opt.safety = atof(value.c_str());
+        else if (arg == "--trains") opt.trains = atoi(value.c_str());
+        else if (arg == "--spawn-every") opt.spawnEvery = atoi(value.c_str());
+        else if (arg == "--seed") opt.seed = (unsigned int)strtoul(value.c_str(), 0, 10);
+        else if (arg == "--weather") opt.weather = value;
+        else if (arg == "--out") opt.output = value;
+        else {
+            cout << "Error: Unknown option " << arg << endl;
+            return false;
+        }
+    }
+
+    if (opt.rows < 5 || opt.columns < 8) {
+        cout << "Error: Level must be at least 5x8" << endl;
+        return false;
+    }
+    if (opt.railSpacing < 2) opt.railSpacing = 2;
+    if (opt.rungSpacing < 2) opt.rungSpacing = 2;
+    if (opt.spawnEvery < 1) opt.spawnEvery = 1;
+    if (opt.trains < 0) opt.trains = 0;
+    if (opt.switches < 0) opt.switches = 0;
+    if (opt.switches > max_switches) {
+        cout << "Error: --switches is at most " << max_switches
+             << " (one letter each, A-Z except S and D)" << endl;
+        return false;
+    }
+    if (opt.weather != "NORMAL" && opt.weather != "RAIN" && opt.weather != "FOG") {
+        cout << "Error: Unknown weather " << opt.weather << endl;
+        return false;
+    }
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// RANDOM NUMBERS
+// ----------------------------------------------------------------------------
+// Raw mt19937 output only, so files are identical across compilers.
+// ----------------------------------------------------------------------------
+static double unitRandom(mt19937 &rng) {
+    return rng() / 4294967296.0;
+}
+
+static int indexRandom(mt19937 &rng, int n) {
+    return (int)(rng() % (uint32_t)n);
+}
+
+// ----------------------------------------------------------------------------
+// GENERATE
+// ----------------------------------------------------------------------------
+int main(int argc, char* argv[]) {
+    GeneratorOptions opt;
+    if (!parseOptions(argc, argv, opt)) {
+        printUsage();
+        return 1;
+    }
+    mt19937 rng(opt.seed);
+
+    vector<string> grid(opt.rows, string(opt.columns, ' '));
+
+    // Rails: one per railSpacing rows, S on the left and D on the right
+    const int firstColumn = 1;
+    const int lastColumn = opt.columns - 2;
+    vector<int> railRows;
+    for (int r = 1; r < opt.rows - 1; r += opt.railSpacing) {
+        railRows.push_back(r);
+        grid[r][firstColumn] = 'S';
+        for (int c = firstColumn + 1; c < lastColumn; c++) {
+            grid[r][c] = (unitRandom(rng) < opt.safety) ? '=' : '-';
+        }
+        grid[r][lastColumn] = 'D';
+    }
+    int rails = (int)railRows.size();
+
+    // Rungs between neighbouring rails, crossings where they meet a rail
+    vector<int> rungColumns;
+    for (int c = firstColumn + opt.rungSpacing; c < lastColumn - 1; c += opt.rungSpacing) {
+        rungColumns.push_back(c);
+    }
+    for (size_t k = 0; k < rungColumns.size(); k++) {
+        int c = rungColumns[k];
+        for (int i = 0; i + 1 < rails; i++) {
+            if (unitRandom(rng) >= opt.crossings) continue;
+            grid[railRows[i]][c] = '+';
+            grid[railRows[i + 1]][c] = '+';
+            for (int r = railRows[i] + 1; r < railRows[i + 1]; r++) grid[r][c] = '|';
+        }
+    }
+
+    // Switches: junctions where a rung leaves a rail both up and down, one
+    // letter each. The rail stops at the switch (the tile after it is left
+    // empty), so a train coming along the rail has no straight exit and the
+    // switch state sends it up or down the rung. Each rung column gets at
+    // most one switch, so trains sent along a rung never meet trains sent
+    // the other way.
+    vector<int> slotRail, slotColumn;
+    for (int i = 0; i < rails; i++) {
+        for (size_t k = 0; k < rungColumns.size(); k++) {
+            int c = rungColumns[k];
+            int r = railRows[i];
+            bool up   = r > 0 && grid[r - 1][c] == '|';
+            bool down = r + 1 < opt.rows && grid[r + 1][c] == '|';
+            if (up && down && c + 2 < lastColumn && grid[r][c + 1] != '+') {
+                slotRail.push_back(i);
+                slotColumn.push_back(c);
+            }
+        }
+    }
+    int slots = (int)slotRail.size();
+    vector<bool> switchInColumn(opt.columns, false);
+    int switchTiles = 0;
+    char highestLetter = 0;
+    for (int n = 0; n < slots && switchTiles < opt.switches; n++) {
+        // Partial Fisher-Yates shuffle visits distinct slots
+        int pick = n + indexRandom(rng, slots - n);
+        swap(slotRail[n], slotRail[pick]);
+        swap(slotColumn[n], slotColumn[pick]);
+        int i = slotRail[n];
+        int c = slotColumn[n];
+        if (switchInColumn[c]) continue;
+        switchInColumn[c] = true;
+        char letter = switchLetters[switchTiles];
+        grid[railRows[i]][c] = letter;
+        grid[railRows[i]][c + 1] = ' ';
+        switchTiles++;
+        if (letter > highestLetter) highestLetter = letter;
+    }
+
+    // Trains: one per rail per batch, rails shuffled every batch
+    vector<int> railOrder(rails);
+    ostringstream trains;
+    for (int t = 0; t < opt.trains; t++) {
+        int slot = t % rails;
+        if (slot == 0) {
+            for (int i = 0; i < rails; i++) railOrder[i] = i;
+            for (int i = rails - 1; i > 0; i--) swap(railOrder[i], railOrder[indexRandom(rng, i + 1)]);
+        }
+        int batch = t / rails;
+        // The loader's first spawn candidate is (row-1, col-1)
+        trains << batch * opt.spawnEvery << " " << firstColumn + 1 << " "
+               << railRows[railOrder[slot]] + 1 << " 1 " << t % 10 << "\n";
+    }
+
+    // Write the level
+    ofstream file;
+    if (!opt.output.empty()) {
+        file.open(opt.output.c_str());
+        if (!file.is_open()) {
+            cout << "Error: Could not open " << opt.output << endl;
+            return 1;
+        }
+    }
+    ostream &out = opt.output.empty() ? cout : file;
+
+    out << "NAME:\nSynthetic " << opt.rows << "x" << opt.columns << " - " << opt.trains
+        << " Trains (seed " << opt.seed << ")\n\n";
+    out << "ROWS:\n" << opt.rows << "\n\n";
+    out << "COLS:\n" << opt.columns << "\n\n";
+    out << "SEED:\n" << opt.seed << "\n\n";
+    out << "WEATHER:\n" << opt.weather << "\n\n";
+    out << "MAP:\n";
+    for (int r = 0; r < opt.rows; r++) out << grid[r] << "\n";
+    out << "\nSWITCHES:\n";
+    // Switch slots are indexed by letter, so every letter up to the highest
+    // used one is listed (S and D included, they simply never appear)
+    for (char letter = 'A'; highestLetter && letter <= highestLetter; letter++) {
+        out << letter << " " << (opt.globalSwitches ? "GLOBAL" : "PER_DIR") << " 0 "
+            << opt.k[0] << " " << opt.k[1] << " " << opt.k[2] << " " << opt.k[3]
+            << " STRAIGHT TURN\n";
+    }
+    out << "\nTRAINS:\n" << trains.str();
+    return 0;
+}
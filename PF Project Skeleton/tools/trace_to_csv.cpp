@@ -0,0 +1,226 @@
+#include "../core/trace_format.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+// ============================================================================
+// TOOLS/TRACE_TO_CSV.CPP - Binary trace to CSV converter
+// ============================================================================
+// Maps a trace.bin/switches.bin/signals.bin file (see core/trace_format.h)
+// and writes the CSV the text loggers would have produced for the same run,
+// byte for byte. --info prints the header instead. --expand rebuilds a delta
+// switch/signal table into one row per switch per tick.
+// ============================================================================
+
+static void printUsage() {
+    cout << "Usage: ./switchback_trace2csv <trace.bin> [--out FILE] [--info] [--expand]\n"
+         << "  --out FILE   output file (default: stdout)\n"
+         << "  --expand     delta tables: write every switch on every tick\n"
+         << "  --info       print the header (level hash, seed, ticks, rows)\n";
+}
+
+// ----------------------------------------------------------------------------
+// Check the header and that the file holds every row it declares.
+// ----------------------------------------------------------------------------
+static bool validateHeader(const TraceHeader &header, size_t fileSize) {
+    if (memcmp(header.magic, trace_magic, sizeof(header.magic)) != 0) {
+        cout << "Error: Not a binary trace file" << endl;
+        return false;
+    }
+    if (header.version != trace_version) {
+        cout << "Error: Unsupported trace version " << header.version << endl;
+        return false;
+    }
+    if (header.table >= (uint32_t)trace_tables ||
+        header.columns != (uint32_t)trace_table_columns[header.table] ||
+        header.chunkRows == 0) {
+        cout << "Error: Unknown trace table layout" << endl;
+        return false;
+    }
+    for (uint32_t c = 0; c < header.columns; c++) {
+        if (header.columnWidth[c] != trace_column_widths[header.table][c]) {
+            cout << "Error: Unknown trace table layout" << endl;
+            return false;
+        }
+    }
+    if (sizeof(TraceHeader) + header.rows * traceRowBytes(header) > fileSize) {
+        cout << "Error: Trace file is truncated" << endl;
+        return false;
+    }
+    return true;
+}
+
+// Value `row` of a column, widened back to int
+static int readValue(const char *column, uint32_t width, uint64_t row) {
+    const char *at = column + row * width;
+    if (width == 1) { int8_t v;  memcpy(&v, at, 1); return v; }
+    if (width == 2) { int16_t v; memcpy(&v, at, 2); return v; }
+    int32_t v;
+    memcpy(&v, at, 4);
+    return v;
+}
+
+// Write one row of the table as CSV
+static void writeCsvRow(const TraceHeader &header, const int *value, FILE *out) {
+    if (header.table == trace_table_trains) {
+        fprintf(out, "%d,%d,%d,%d,%d,%d\n",
+                value[0], value[1], value[2], value[3], value[4], value[5]);
+    } else if (header.table == trace_table_switches) {
+        fprintf(out, "%d,%c,%d,%d\n", value[0], (char)value[1], value[2], value[3]);
+    } else {
+        fprintf(out, "%d,%c,%s\n", value[0], (char)value[1], traceSignalName(value[2]));
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Visit every row in file order (value[c] is column c).
+// ----------------------------------------------------------------------------
+template <typename Visitor>
+static void forEachRow(const char *base, const TraceHeader &header, Visitor &visit) {
+    uint64_t chunks = (header.rows + header.chunkRows - 1) / header.chunkRows;
+    for (uint64_t chunk = 0; chunk < chunks; chunk++) {
+        uint64_t rows = header.rows - chunk * header.chunkRows;
+        if (rows > header.chunkRows) rows = header.chunkRows;
+
+        const char *column[trace_max_columns];
+        for (uint32_t c = 0; c < header.columns; c++) {
+            column[c] = base + traceColumnOffset(header, chunk, c);
+        }
+
+        for (uint64_t r = 0; r < rows; r++) {
+            int value[trace_max_columns];
+            for (uint32_t c = 0; c < header.columns; c++) {
+                value[c] = readValue(column[c], header.columnWidth[c], r);
+            }
+            visit(value);
+        }
+    }
+}
+
+// Rows as stored
+struct CsvWriter {
+    const TraceHeader &header;
+    FILE *out;
+    void operator()(const int *value) { writeCsvRow(header, value, out); }
+};
+
+// ----------------------------------------------------------------------------
+// Rebuild a delta table: every switch, in first-keyframe order, on every
+// logged tick, each carrying its latest row forward.
+// ----------------------------------------------------------------------------
+struct DeltaExpander {
+    const TraceHeader &header;
+    FILE *out;
+    int tick;                               // Tick being collected
+    vector<int> letters;                    // Switch order of the first keyframe
+    vector<vector<int> > latest;            // Last row per letter (by letter code)
+
+    // Write the full state for every tick up to (not including) `until`
+    void flushUntil(int until) {
+        for (; tick < until; tick++) {
+            for (size_t k = 0; k < letters.size(); k++) {
+                vector<int> &row = latest[letters[k]];
+                row[0] = tick;
+                writeCsvRow(header, &row[0], out);
+            }
+        }
+    }
+    void operator()(const int *value) {
+        if (value[0] > tick) flushUntil(value[0]);
+        int letter = value[1] & 0xFF;
+        if (latest[letter].empty()) letters.push_back(letter);
+        latest[letter].assign(value, value + header.columns);
+    }
+};
+
+static void writeCsv(const char *base, const TraceHeader &header, FILE *out, bool expand) {
+    fputs(trace_csv_headers[header.table], out);
+
+    if (expand && header.keyframeTicks > 0 && header.firstTick >= 0) {
+        DeltaExpander expander = { header, out, header.firstTick, vector<int>(),
+                                   vector<vector<int> >(256) };
+        forEachRow(base, header, expander);
+        expander.flushUntil(header.lastTick + 1);
+        return;
+    }
+    CsvWriter writer = { header, out };
+    forEachRow(base, header, writer);
+}
+
+int main(int argc, char* argv[]) {
+    const char *input = 0;
+    const char *output = 0;
+    bool info = false;
+    bool expand = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--info") == 0) info = true;
+        else if (strcmp(argv[i], "--expand") == 0) expand = true;
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) output = argv[++i];
+        else if (argv[i][0] != '-' && !input) input = argv[i];
+        else {
+            printUsage();
+            return 1;
+        }
+    }
+    if (!input) {
+        printUsage();
+        return 1;
+    }
+
+    int fd = open(input, O_RDONLY);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0) {
+        cout << "Error: Could not open trace file: " << input << endl;
+        return 1;
+    }
+    size_t fileSize = (size_t)status.st_size;
+    if (fileSize < sizeof(TraceHeader)) {
+        cout << "Error: Not a binary trace file" << endl;
+        close(fd);
+        return 1;
+    }
+    void *mapped = mmap(0, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        cout << "Error: Could not map trace file: " << input << endl;
+        return 1;
+    }
+
+    const char *base = (const char*)mapped;
+    TraceHeader header;
+    memcpy(&header, base, sizeof(header));
+    if (!validateHeader(header, fileSize)) {
+        munmap(mapped, fileSize);
+        return 1;
+    }
+
+    if (info) {
+        const char *tables[trace_tables] = { "trains", "switches", "signals" };
+        printf("table:      %s\n", tables[header.table]);
+        printf("level hash: %016llx\n", (unsigned long long)header.levelHash);
+        printf("seed:       %d\n", header.seed);
+        printf("ticks:      %d..%d\n", header.firstTick, header.lastTick);
+        printf("rows:       %llu\n", (unsigned long long)header.rows);
+        if (header.keyframeTicks > 0) printf("keyframes:  every %u ticks (delta)\n", header.keyframeTicks);
+    } else {
+        FILE *out = output ? fopen(output, "w") : stdout;
+        if (!out) {
+            cout << "Error: Could not open output file: " << output << endl;
+            munmap(mapped, fileSize);
+            return 1;
+        }
+        writeCsv(base, header, out, expand);
+        if (output) fclose(out);
+    }
+
+    munmap(mapped, fileSize);
+    return 0;
+}